@@ -0,0 +1,138 @@
+#ifndef _BUFFERED_WRITER_HPP_
+#define _BUFFERED_WRITER_HPP_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <sys/uio.h>
+#include "socket.hpp"
+
+namespace npl {
+
+// Output buffer for a stream socket: small writes are gathered in user
+// space and leave in one system call (and as few segments as possible)
+// when the buffered bytes reach threshold, on flush(), or at the end of an
+// event-loop tick (reactor::defer). A write that crosses the threshold goes
+// out together with what is buffered in one writev, without copying it.
+//
+// The writer coalesces by itself, so by default it sets TCP_NODELAY on TCP
+// sockets (AF_INET, AF_INET6): a flush is not held back by Nagle waiting
+// for the ACK of the previous one.
+//
+// Works on blocking and non-blocking sockets. On a non-blocking socket a
+// flush may stop short with would_block(): the rest stays buffered, to be
+// flushed again when the socket is writable (EPOLLOUT).
+
+template<int F, int type>
+class buffered_writer {
+private:
+    socket<F,type>& _sock;
+    size_t _threshold;
+    std::vector<std::byte> _buf;
+    size_t _head = 0;                   // First byte not yet sent
+    size_t _writes = 0;                 // System calls issued
+
+    void append(std::span<const std::byte> data)
+    {
+        if (_head > 0 && _head >= _buf.size() / 2) {     // Drop the sent prefix
+            _buf.erase(_buf.begin(), _buf.begin() + _head);
+            _head = 0;
+        }
+        _buf.insert(_buf.end(), data.begin(), data.end());
+    }
+
+    void consume(size_t n)
+    {
+        _head += n;
+        if (_head == _buf.size()) {
+            _buf.clear();
+            _head = 0;
+        }
+    }
+
+public:
+    explicit buffered_writer(socket<F,type>& sock, size_t threshold = 1 << 14, bool nodelay = true)
+    : _sock(sock)
+    , _threshold(threshold)
+    {
+        _buf.reserve(threshold);
+        if constexpr (F == AF_INET || F == AF_INET6) {
+            if (nodelay)
+                _sock.set_nodelay();
+        }
+    }
+
+    buffered_writer(const buffered_writer&) = delete;
+    buffered_writer& operator=(const buffered_writer&) = delete;
+
+    // Buffer data, or send it with the buffered bytes once they reach the
+    // threshold. Returns the bytes handed to the kernel by this call (0 if
+    // only buffered); on error (or would_block) whatever was not sent,
+    // data included, stays buffered.
+    io_result write(std::span<const std::byte> data)
+    {
+        if (pending() + data.size() < _threshold) {
+            append(data);
+            return io_result{};
+        }
+        std::ptrdiff_t sent = 0;
+        while (pending() > 0 || !data.empty()) {
+            iovec iov[2] = { as_iovec(std::span<const std::byte>(_buf).subspan(_head)), as_iovec(data) };
+            auto r = io_result::from(_sock.writev(iov));
+            if (!r) {
+                if (r.error == EINTR)
+                    continue;
+                append(data);
+                return io_result{sent, r.error};
+            }
+            ++_writes;
+            sent += r.bytes;
+            size_t from_buf = std::min<size_t>(r.bytes, pending());
+            consume(from_buf);
+            data = data.subspan(r.bytes - from_buf);
+        }
+        return io_result{sent, 0};
+    }
+
+    // Send everything buffered. ok() once the buffer is empty; would_block()
+    // on a full non-blocking socket; otherwise the write error.
+    io_result flush()
+    {
+        std::ptrdiff_t sent = 0;
+        while (pending() > 0) {
+            auto r = _sock.try_write(std::span<const std::byte>(_buf).subspan(_head));
+            if (!r) {
+                if (r.error == EINTR)
+                    continue;
+                return io_result{sent, r.error};
+            }
+            ++_writes;
+            sent += r.bytes;
+            consume(r.bytes);
+        }
+        return io_result{sent, 0};
+    }
+
+    // Bytes buffered, not yet sent
+    size_t pending() const
+    {
+        return _buf.size() - _head;
+    }
+
+    size_t threshold() const
+    {
+        return _threshold;
+    }
+
+    size_t writes() const
+    {
+        return _writes;
+    }
+};
+
+}
+
+
+#endif
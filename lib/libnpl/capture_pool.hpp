@@ -0,0 +1,150 @@
+#ifndef _CAPTURE_POOL_HPP_
+#define _CAPTURE_POOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <iostream>
+#include <linux/if_packet.h>
+#include "packet_ring.hpp"
+#include "sockaddress.hpp"
+#include "socket.hpp"
+
+namespace npl {
+
+// Multi-threaded capture: N AF_PACKET sockets joined to one PACKET_FANOUT
+// group, each with its own TPACKET_V3 ring and its own pinned thread.
+//
+// With PACKET_FANOUT_HASH (the default) the kernel picks the socket from the
+// flow hash, so both directions of a flow always reach the same worker and
+// per-flow state can be kept per worker without locks. PACKET_FANOUT_CPU
+// follows the NIC RSS steering instead, PACKET_FANOUT_ROLLOVER fills one
+// socket before moving on (no flow affinity).
+
+class capture_pool {
+public:
+    struct alignas(64) worker_stats {
+        std::atomic<uint64_t> packets{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> blocks{0};
+        std::atomic<uint64_t> drops{0};   // Kernel drops, updated about once per second
+    };
+
+private:
+    struct worker {
+        socket<AF_PACKET, SOCK_RAW> sock;
+        packet_ring ring;
+        worker_stats stats;
+        std::thread thread;
+
+        worker(const sockaddress<AF_PACKET>& dev, int group, int mode,
+               unsigned block_size, unsigned block_nr)
+        : sock(htons(ETH_P_ALL))
+        , ring(sock, block_size, block_nr)
+        {
+            sock.bind(dev);
+            sock.set_fanout(group, mode);
+        }
+    };
+
+    std::vector<std::unique_ptr<worker>> _workers;
+    std::atomic<bool> _running{false};
+
+public:
+    capture_pool(const std::string& ifname, unsigned workers,
+                 int mode = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG,
+                 int group = ::getpid() & 0xffff,
+                 unsigned block_size = 1 << 22,
+                 unsigned block_nr = 64)
+    {
+        sockaddress<AF_PACKET> dev(ifname);
+        for (unsigned i = 0; i < workers; ++i) {
+            _workers.push_back(std::make_unique<worker>(dev, group, mode, block_size, block_nr));
+        }
+    }
+
+    capture_pool(const capture_pool&) = delete;
+    capture_pool& operator=(const capture_pool&) = delete;
+
+    ~capture_pool()
+    {
+        this->stop();
+    }
+
+    unsigned size() const
+    {
+        return _workers.size();
+    }
+
+    const worker_stats& stats(unsigned i) const
+    {
+        return _workers[i]->stats;
+    }
+
+    // Start one thread per socket (worker i pinned to CPU i modulo the core
+    // count). func(i, frame) is called from worker i only.
+    template<typename F>
+    void start(F func)
+    {
+        _running = true;
+        unsigned ncpu = std::max(1u, std::thread::hardware_concurrency());   // 0 if unknown
+        for (unsigned i = 0; i < _workers.size(); ++i)
+        {
+            auto& w = *_workers[i];
+            w.thread = std::thread([this, &w, i, ncpu, func]() mutable {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(i % ncpu, &cpus);
+                if (int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus); err != 0) {
+                    std::cerr << "capture_pool: worker " << i << " not pinned to CPU " << i % ncpu
+                              << ": " << std::strerror(err) << std::endl;
+                }
+
+                auto last = std::chrono::steady_clock::now();
+                while (_running.load(std::memory_order_relaxed))
+                {
+                    uint64_t bytes = 0;
+                    auto n = w.ring.dispatch([&](const packet_ring::frame& f) {
+                        bytes += f.len();
+                        func(i, f);
+                    }, 100);
+
+                    if (n > 0) {
+                        w.stats.packets.fetch_add(n, std::memory_order_relaxed);
+                        w.stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+                        w.stats.blocks.fetch_add(1, std::memory_order_relaxed);
+                    }
+
+                    auto now = std::chrono::steady_clock::now();
+                    if (now - last >= std::chrono::seconds(1)) {
+                        w.stats.drops.fetch_add(w.ring.stats().tp_drops, std::memory_order_relaxed);
+                        last = now;
+                    }
+                }
+            });
+        }
+    }
+
+    void stop()
+    {
+        _running = false;
+        for (auto& w : _workers) {
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+};
+
+}
+
+
+#endif
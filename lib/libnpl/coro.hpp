@@ -0,0 +1,371 @@
+#ifndef _CORO_HPP_
+#define _CORO_HPP_
+
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+#include "reactor.hpp"
+
+namespace npl {
+
+// C++20 coroutines on top of the epoll reactor.
+//
+// task<T> is a lazily started coroutine returning T: it runs when awaited
+// (co_await t) and resumes its awaiter when done, or is started detached
+// with scheduler::spawn. The socket::async_* methods return awaitables that
+// complete at once when the call does not block, and otherwise park the
+// coroutine on the scheduler until the fd is ready, so a whole server runs
+// on one thread with a small heap frame per connection instead of a stack.
+
+template<typename T = void>
+class task;
+
+namespace detail {
+
+    struct promise_base {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        // Resume the awaiting coroutine (symmetric transfer: no stack growth)
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+
+            template<typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                auto c = h.promise().continuation;
+                return c ? c : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void unhandled_exception()
+        {
+            error = std::current_exception();
+        }
+    };
+
+    template<typename T>
+    struct promise : promise_base {
+        std::optional<T> value;
+
+        task<T> get_return_object();
+
+        void return_value(T v)
+        {
+            value.emplace(std::move(v));
+        }
+
+        T result()
+        {
+            if (error)
+                std::rethrow_exception(error);
+            return std::move(*value);
+        }
+    };
+
+    template<>
+    struct promise<void> : promise_base {
+        task<void> get_return_object();
+
+        void return_void() {}
+
+        void result()
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    // Fire and forget wrapper for scheduler::spawn: frees itself when done
+    struct detached {
+        struct promise_type {
+            detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+}
+
+template<typename T>
+class task {
+public:
+    typedef detail::promise<T> promise_type;
+
+private:
+    std::coroutine_handle<promise_type> _h;
+
+public:
+    explicit task(std::coroutine_handle<promise_type> h)
+    : _h(h)
+    {}
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    task(task&& rhs)
+    : _h(std::exchange(rhs._h, nullptr))
+    {}
+
+    task& operator=(task&& rhs)
+    {
+        if (this != &rhs) {
+            if (_h)
+                _h.destroy();
+            _h = std::exchange(rhs._h, nullptr);
+        }
+        return *this;
+    }
+
+    ~task()
+    {
+        if (_h)
+            _h.destroy();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct awaiter {
+            std::coroutine_handle<promise_type> h;
+
+            bool await_ready() noexcept
+            {
+                return !h || h.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept
+            {
+                h.promise().continuation = c;
+                return h;
+            }
+
+            T await_resume()
+            {
+                return h.promise().result();
+            }
+        };
+        return awaiter{_h};
+    }
+};
+
+template<typename T>
+task<T> detail::promise<T>::get_return_object()
+{
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> detail::promise<void>::get_return_object()
+{
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+
+// Runs coroutines parked on fd readiness. Each fd is registered once,
+// edge-triggered for both directions, on its first wait; at most one reader
+// and one writer may wait on it at a time. Call release(fd) before closing
+// a socket that has been awaited on.
+
+class scheduler {
+public:
+    // A parked operation: retried when the fd becomes ready
+    struct waiter {
+        std::coroutine_handle<> handle;
+        virtual bool retry() = 0;          // True once complete (not blocking)
+    protected:
+        ~waiter() = default;
+    };
+
+private:
+    struct fd_state {
+        waiter* reader = nullptr;
+        waiter* writer = nullptr;
+        bool registered = false;
+    };
+
+    npl::reactor _loop;
+    std::vector<fd_state> _fds;
+
+    void on_ready(int fd, uint32_t events)
+    {
+        // Resuming may release this fd (or register others): index afresh
+        constexpr uint32_t rd = EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR;
+        constexpr uint32_t wr = EPOLLOUT | EPOLLHUP | EPOLLERR;
+        if ((events & rd) && _fds[fd].reader && _fds[fd].reader->retry()) {
+            auto h = std::exchange(_fds[fd].reader, nullptr)->handle;
+            h.resume();
+        }
+        if ((events & wr) && static_cast<size_t>(fd) < _fds.size() &&
+            _fds[fd].writer && _fds[fd].writer->retry()) {
+            auto h = std::exchange(_fds[fd].writer, nullptr)->handle;
+            h.resume();
+        }
+    }
+
+public:
+    explicit scheduler(int max_events = 256)
+    : _loop(max_events)
+    {}
+
+    scheduler(const scheduler&) = delete;
+    scheduler& operator=(const scheduler&) = delete;
+
+    // The underlying reactor, for callbacks alongside coroutines
+    npl::reactor& reactor()
+    {
+        return _loop;
+    }
+
+    // Start t now; it runs up to its first suspension before spawn returns.
+    // An exception escaping a spawned task terminates, as with std::thread.
+    void spawn(task<> t)
+    {
+        [](task<> t) -> detail::detached { co_await std::move(t); }(std::move(t));
+    }
+
+    void wait(int fd, uint32_t events, waiter* w)
+    {
+        if (static_cast<size_t>(fd) >= _fds.size()) {
+            _fds.resize(fd + 1);
+        }
+        auto& s = _fds[fd];
+        ((events & EPOLLOUT) ? s.writer : s.reader) = w;
+        if (!s.registered) {
+            _loop.add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                      [this, fd](uint32_t ev) { on_ready(fd, ev); });
+            s.registered = true;
+        }
+    }
+
+    // Forget fd before it is closed (pending waiters are dropped)
+    void release(int fd)
+    {
+        if (static_cast<size_t>(fd) < _fds.size() && _fds[fd].registered) {
+            _loop.remove(fd);
+            _fds[fd] = fd_state{};
+        }
+    }
+
+    template<int F, int type>
+    void release(const socket<F,type>& sock)
+    {
+        this->release(sock.fd());
+    }
+
+    // Awaitable for a non-blocking call: op() returns std::optional<R>,
+    // nullopt meaning "would block". events is EPOLLIN or EPOLLOUT.
+    template<typename Op>
+    auto io(int fd, uint32_t events, Op op)
+    {
+        typedef typename decltype(op())::value_type R;
+
+        struct awaiter final : waiter {
+            scheduler& sched;
+            int fd;
+            uint32_t events;
+            Op op;
+            std::optional<R> result;
+            std::exception_ptr error;
+            int saved_errno = 0;
+
+            awaiter(scheduler& s, int f, uint32_t ev, Op o)
+            : sched(s), fd(f), events(ev), op(std::move(o))
+            {}
+
+            bool retry() override
+            {
+                try {
+                    result = op();
+                }
+                catch (...) {
+                    error = std::current_exception();
+                    return true;
+                }
+                saved_errno = errno;
+                return result.has_value();
+            }
+
+            bool await_ready()
+            {
+                return retry();
+            }
+
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                handle = h;
+                sched.wait(fd, events, this);
+            }
+
+            R await_resume()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+                errno = saved_errno;
+                return std::move(*result);
+            }
+        };
+        return awaiter(*this, fd, events, std::move(op));
+    }
+
+    // Suspend the calling coroutine for d, e.g. to back off after an error
+    // that retrying at once would only repeat. Needs no fd (reactor timer).
+    auto sleep_for(std::chrono::milliseconds d)
+    {
+        struct awaiter {
+            npl::reactor& loop;
+            std::chrono::milliseconds d;
+
+            bool await_ready()
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                loop.after(d, [h] { h.resume(); });
+            }
+
+            void await_resume() {}
+        };
+        return awaiter{_loop, d};
+    }
+
+    void run()
+    {
+        _loop.run();
+    }
+
+    void stop()
+    {
+        _loop.stop();
+    }
+
+    int poll(int timeout_ms = -1)
+    {
+        return _loop.poll(timeout_ms);
+    }
+};
+
+}
+
+
+#endif
@@ -0,0 +1,459 @@
+#ifndef _FLOW_TABLE_HPP_
+#define _FLOW_TABLE_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include "decoder.hpp"
+#include "headers.hpp"
+#include "packet.hpp"
+
+namespace npl {
+
+// Canonical (direction-independent) 5-tuple: the (address, port) pair that
+// compares lower is stored first, so both directions of a connection map to
+// the same key. IPv4 addresses are stored v4-mapped (::ffff:a.b.c.d).
+
+struct flow_key {
+    in6_addr  lo_addr;
+    in6_addr  hi_addr;
+    u_int16_t lo_port = 0;
+    u_int16_t hi_port = 0;
+    u_int8_t  proto = 0;
+    u_int8_t  _pad[3] = {0, 0, 0};     // Kept zeroed: hashed as five 64-bit words
+
+    flow_key()
+    {
+        memset(&lo_addr, 0, sizeof(lo_addr));
+        memset(&hi_addr, 0, sizeof(hi_addr));
+    }
+
+    // Ports in host byte order
+    flow_key(const in6_addr& src, const in6_addr& dst, u_int16_t sport, u_int16_t dport, u_int8_t protocol)
+    : proto(protocol)
+    {
+        int cmp = memcmp(&src, &dst, sizeof(in6_addr));
+        if (cmp < 0 || (cmp == 0 && sport <= dport)) {
+            lo_addr = src; lo_port = sport;
+            hi_addr = dst; hi_port = dport;
+        } else {
+            lo_addr = dst; lo_port = dport;
+            hi_addr = src; hi_port = sport;
+        }
+    }
+
+    // IPv4 addresses in network byte order, ports in host byte order
+    flow_key(u_int32_t src, u_int32_t dst, u_int16_t sport, u_int16_t dport, u_int8_t protocol)
+    : flow_key(mapped(src), mapped(dst), sport, dport, protocol)
+    {}
+
+    static in6_addr mapped(u_int32_t v4)
+    {
+        in6_addr a;
+        memset(&a, 0, sizeof(a));
+        a.s6_addr[10] = a.s6_addr[11] = 0xff;
+        memcpy(&a.s6_addr[12], &v4, sizeof(v4));
+        return a;
+    }
+
+    // Key of a parsed packet: IPv4 or IPv6, ports from TCP/UDP (0 otherwise).
+    // Non-first fragments get proto 0 and ports 0, as from a decoded batch.
+    template<hdr h>
+    static std::optional<flow_key> from(const packet<h>& pkt)
+    {
+        in6_addr src, dst;
+        u_int8_t protocol = pkt.l4_proto();
+        u_int16_t sport = 0, dport = 0;
+
+        if (auto ip = pkt.template get<hdr::ipv4>()) {
+            auto c = ip->c_hdr();
+            src = mapped(c.ip_src.s_addr);
+            dst = mapped(c.ip_dst.s_addr);
+        } else if (auto ip6 = pkt.template get<hdr::ipv6>()) {
+            src = ip6->src_addr();
+            dst = ip6->dst_addr();
+        } else {
+            return std::nullopt;
+        }
+
+        if (auto tcp = pkt.template get<hdr::tcp>()) {
+            sport = tcp->srcport();
+            dport = tcp->dstport();
+        } else if (auto udp = pkt.template get<hdr::udp>()) {
+            sport = udp->srcport();
+            dport = udp->dstport();
+        }
+        return flow_key(src, dst, sport, dport, protocol);
+    }
+
+    // Key of frame i of a decoded batch
+    template<size_t N>
+    static std::optional<flow_key> from(const frame_batch<N>& b, size_t i)
+    {
+        if (b.l3_offset[i] == 0)
+            return std::nullopt;
+        if (b.ethertype[i] == ETHERTYPE_IP)
+            return flow_key(b.src_ip[i], b.dst_ip[i], b.src_port[i], b.dst_port[i], b.l4_proto[i]);
+        return flow_key(b.src_ip6[i], b.dst_ip6[i], b.src_port[i], b.dst_port[i], b.l4_proto[i]);
+    }
+
+    u_int64_t hash() const
+    {
+        u_int64_t w[5];
+        memcpy(w, this, sizeof(w));
+        u_int64_t h = 0x9e3779b97f4a7c15ULL;
+        for (auto x : w) {
+            h = (h ^ x) * 0xbf58476d1ce4e5b9ULL;
+            h ^= h >> 31;
+        }
+        return h;
+    }
+
+    bool operator==(const flow_key& rhs) const
+    {
+        return memcmp(this, &rhs, sizeof(flow_key)) == 0;
+    }
+};
+
+static_assert(sizeof(flow_key) == 40, "flow_key is hashed as five 64-bit words");
+
+// One slot of the table: exactly one cache line. Occupancy is its own bit,
+// so no counter value can turn a live slot into an empty one; the home slot
+// is recomputed from the key where needed (deletion, merge).
+struct alignas(64) flow {
+    flow_key  key;
+    u_int64_t packets : 63;
+    u_int64_t used : 1;     // 0: empty slot
+    u_int64_t bytes;
+    u_int32_t first;        // Timestamps (seconds, capture clock)
+    u_int32_t last;
+};
+
+static_assert(sizeof(flow) == 64, "one flow per cache line");
+
+// Open-addressing flow table with linear probing and backward-shift deletion
+// (no tombstones). Memory is 64 bytes per slot, reserved up front: capacity
+// is max_flows / max_load rounded up to a power of two, e.g. 10M flows at
+// the default 0.75 load take 16M slots = 1 GiB, about 107 bytes per flow.
+// The slots are an anonymous mapping with MADV_HUGEPAGE: pages are only
+// faulted in when touched, and 2 MB pages spare most TLB misses of random
+// lookups in a large table.
+//
+// Not thread safe: give each capture worker its own table (PACKET_FANOUT_HASH
+// keeps both directions of a flow on one worker) or use sharded_flow_table.
+
+class flow_table {
+private:
+    flow* _slots = nullptr;
+    size_t _mask;
+    size_t _size = 0;
+    size_t _max_size;
+
+    size_t home(u_int64_t hash) const
+    {
+        return hash & _mask;
+    }
+
+    // Remove slot i, pulling back the entries of its cluster that may move
+    void erase_at(size_t i)
+    {
+        size_t j = i;
+        for (;;)
+        {
+            j = (j + 1) & _mask;
+            if (!_slots[j].used)
+                break;
+            size_t h = home(_slots[j].key.hash());
+            // Move j into the hole unless its home lies cyclically in (i, j]
+            bool stays = (i <= j) ? (i < h && h <= j) : (i < h || h <= j);
+            if (!stays) {
+                _slots[i] = _slots[j];
+                i = j;
+            }
+        }
+        _slots[i].used = 0;
+        --_size;
+    }
+
+    // The slot of key, or a new zeroed one stamped with ts; nullptr if full
+    flow* find_or_insert(const flow_key& key, u_int64_t hash, u_int32_t ts)
+    {
+        for (size_t i = home(hash); ; i = (i + 1) & _mask)
+        {
+            auto& f = _slots[i];
+            if (!f.used) {
+                if (_size == _max_size)
+                    return nullptr;
+                f.key = key;
+                f.used = 1;
+                f.packets = 0;
+                f.bytes = 0;
+                f.first = f.last = ts;
+                ++_size;
+                return &f;
+            }
+            if (f.key == key)
+                return &f;
+        }
+    }
+
+public:
+    // Holds at least max_flows, up to max_load of the (rounded up) capacity
+    explicit flow_table(size_t max_flows, double max_load = 0.75)
+    {
+        size_t slots = std::bit_ceil(static_cast<size_t>(std::ceil(max_flows / max_load)) + 1);
+        _mask = slots - 1;
+        _max_size = std::min(static_cast<size_t>(slots * max_load), slots - 1);
+
+        void* map = ::mmap(nullptr, memory(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "flow_table mmap");
+        }
+        ::madvise(map, memory(), MADV_HUGEPAGE);        // Best effort
+        _slots = static_cast<flow*>(map);               // Zero filled: all slots empty
+    }
+
+    flow_table(const flow_table&) = delete;
+    flow_table& operator=(const flow_table&) = delete;
+
+    flow_table(flow_table&& rhs)
+    : _slots(rhs._slots), _mask(rhs._mask), _size(rhs._size), _max_size(rhs._max_size)
+    {
+        rhs._slots = nullptr;
+    }
+
+    ~flow_table()
+    {
+        if (_slots != nullptr) {
+            ::munmap(_slots, memory());
+        }
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    size_t max_size() const
+    {
+        return _max_size;
+    }
+
+    size_t capacity() const
+    {
+        return _mask + 1;
+    }
+
+    size_t memory() const
+    {
+        return capacity() * sizeof(flow);
+    }
+
+    // Start loading the home slot of a key: when a batch of frames is at
+    // hand, prefetching a few keys ahead of update() overlaps the cache misses
+    void prefetch(u_int64_t hash) const
+    {
+        __builtin_prefetch(&_slots[home(hash)], 1);
+    }
+
+    // Account one packet of len bytes seen at ts (seconds). Returns the flow,
+    // or nullptr if it is new and the table is full (see max_size()).
+    flow* update(const flow_key& key, u_int32_t len, u_int32_t ts)
+    {
+        return update(key, key.hash(), len, ts);
+    }
+
+    flow* update(const flow_key& key, u_int64_t hash, u_int32_t len, u_int32_t ts)
+    {
+        auto f = find_or_insert(key, hash, ts);
+        if (f != nullptr) {
+            ++f->packets;
+            f->bytes += len;
+            f->last = ts;
+        }
+        return f;
+    }
+
+    const flow* find(const flow_key& key) const
+    {
+        for (size_t i = home(key.hash()); ; i = (i + 1) & _mask)
+        {
+            auto& f = _slots[i];
+            if (!f.used)
+                return nullptr;
+            if (f.key == key)
+                return &f;
+        }
+    }
+
+    // Remove the flows idle for at least idle seconds at time now, calling
+    // on_expire(const flow&) on each first. Scans the whole table: call it
+    // periodically (e.g. once per second of capture time), not per packet.
+    // Flows last seen after now (reordered timestamps, merged tables) stay.
+    template<typename F>
+    size_t expire(u_int32_t now, u_int32_t idle, F&& on_expire)
+    {
+        if (_size == 0)
+            return 0;
+
+        // Start right after an empty slot, so that no cluster wraps around
+        // the scan origin and backward shifts only move entries into the
+        // slot being examined
+        size_t start = 0;
+        while (_slots[start].used)
+            ++start;
+
+        size_t removed = 0;
+        for (size_t n = 1; n <= _mask + 1; ++n)
+        {
+            size_t i = (start + n) & _mask;
+            while (_slots[i].used && _slots[i].last <= now && now - _slots[i].last >= idle) {
+                on_expire(static_cast<const flow&>(_slots[i]));
+                erase_at(i);
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
+    size_t expire(u_int32_t now, u_int32_t idle)
+    {
+        return expire(now, idle, [](const flow&) {});
+    }
+
+    // Add the flows of another table (e.g. of another worker): counters are
+    // summed, first/last widened. Returns the number of flows that did not fit.
+    size_t merge(const flow_table& rhs)
+    {
+        size_t dropped = 0;
+        rhs.for_each([this, &dropped](const flow& f) {
+            auto g = find_or_insert(f.key, f.key.hash(), f.first);
+            if (g == nullptr) {
+                ++dropped;
+                return;
+            }
+            g->packets += f.packets;
+            g->bytes   += f.bytes;
+            g->first    = std::min(g->first, f.first);
+            g->last     = std::max(g->last, f.last);
+        });
+        return dropped;
+    }
+
+    template<typename F>
+    void for_each(F&& func) const
+    {
+        for (size_t i = 0; i <= _mask; ++i) {
+            if (_slots[i].used)
+                func(static_cast<const flow&>(_slots[i]));
+        }
+    }
+
+    // Drop every flow and give the pages back (they fault in again as zeros)
+    void clear()
+    {
+        ::madvise(_slots, memory(), MADV_DONTNEED);
+        _size = 0;
+    }
+};
+
+// Concurrent variant: flows are spread over independent flow_tables by the
+// high bits of their hash, each behind its own mutex, so workers only
+// contend when they hit the same shard at the same time.
+
+class sharded_flow_table {
+private:
+    struct alignas(64) shard {
+        mutable std::mutex lock;
+        flow_table table;
+
+        shard(size_t max_flows, double max_load)
+        : table(max_flows, max_load)
+        {}
+    };
+
+    std::vector<std::unique_ptr<shard>> _shards;
+
+    shard& shard_of(u_int64_t hash) const
+    {
+        return *_shards[(hash >> 32) % _shards.size()];
+    }
+
+public:
+    explicit sharded_flow_table(size_t max_flows, unsigned shards = 64, double max_load = 0.75)
+    {
+        for (unsigned i = 0; i < shards; ++i) {
+            _shards.push_back(std::make_unique<shard>((max_flows + shards - 1) / shards, max_load));
+        }
+    }
+
+    // Returns false if the flow is new and its shard is full
+    bool update(const flow_key& key, u_int32_t len, u_int32_t ts)
+    {
+        auto hash = key.hash();
+        auto& s = shard_of(hash);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.table.update(key, hash, len, ts) != nullptr;
+    }
+
+    std::optional<flow> find(const flow_key& key) const
+    {
+        auto& s = shard_of(key.hash());
+        std::lock_guard<std::mutex> guard(s.lock);
+        if (auto f = s.table.find(key))
+            return *f;
+        return std::nullopt;
+    }
+
+    // Shards are locked one at a time: on_expire runs under the shard lock
+    template<typename F>
+    size_t expire(u_int32_t now, u_int32_t idle, F&& on_expire)
+    {
+        size_t removed = 0;
+        for (auto& s : _shards) {
+            std::lock_guard<std::mutex> guard(s->lock);
+            removed += s->table.expire(now, idle, on_expire);
+        }
+        return removed;
+    }
+
+    size_t expire(u_int32_t now, u_int32_t idle)
+    {
+        return expire(now, idle, [](const flow&) {});
+    }
+
+    size_t size() const
+    {
+        size_t n = 0;
+        for (auto& s : _shards) {
+            std::lock_guard<std::mutex> guard(s->lock);
+            n += s->table.size();
+        }
+        return n;
+    }
+
+    size_t memory() const
+    {
+        size_t n = 0;
+        for (auto& s : _shards)
+            n += s->table.memory();
+        return n;
+    }
+};
+
+}
+
+
+#endif
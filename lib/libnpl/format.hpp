@@ -0,0 +1,107 @@
+#ifndef _FORMAT_HPP_
+#define _FORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+
+namespace npl {
+
+// Address formatting into caller-supplied buffers: no streams, no heap.
+// Each function NUL terminates and returns the length without the NUL.
+// Octets are converted through precomputed tables (two hex digits or up
+// to three decimal digits per byte) instead of per-character arithmetic.
+
+constexpr size_t MAC_STRLEN  = 18;                // "xx:xx:xx:xx:xx:xx" + NUL
+constexpr size_t IPV4_STRLEN = INET_ADDRSTRLEN;   // "255.255.255.255" + NUL
+constexpr size_t IPV6_STRLEN = INET6_ADDRSTRLEN;
+
+namespace detail {
+
+    struct hex_table {
+        char digits[256][2];
+
+        constexpr hex_table()
+        : digits()
+        {
+            constexpr char hex[] = "0123456789abcdef";
+            for (int i = 0; i < 256; ++i) {
+                digits[i][0] = hex[i >> 4];
+                digits[i][1] = hex[i & 0xf];
+            }
+        }
+    };
+
+    struct dec_table {
+        char digits[256][4];    // Up to three digits, then the length
+
+        constexpr dec_table()
+        : digits()
+        {
+            for (int i = 0; i < 256; ++i) {
+                int n = 0;
+                if (i >= 100) digits[i][n++] = '0' + i / 100;
+                if (i >= 10)  digits[i][n++] = '0' + (i / 10) % 10;
+                digits[i][n++] = '0' + i % 10;
+                digits[i][3] = n;
+            }
+        }
+    };
+
+    inline constexpr hex_table hex_octets;
+    inline constexpr dec_table dec_octets;
+
+}
+
+// Out must hold MAC_STRLEN chars
+inline size_t
+format_mac(const u_int8_t* mac, char* out)
+{
+    for (int i = 0; i < 6; ++i) {
+        memcpy(out + 3 * i, detail::hex_octets.digits[mac[i]], 2);
+        out[3 * i + 2] = ':';
+    }
+    out[17] = '\0';
+    return 17;
+}
+
+// Address in network byte order; out must hold IPV4_STRLEN chars
+inline size_t
+format_ipv4(u_int32_t addr, char* out)
+{
+    auto octets = reinterpret_cast<const u_int8_t*>(&addr);
+    size_t n = 0;
+    for (int i = 0; i < 4; ++i) {
+        auto& d = detail::dec_octets.digits[octets[i]];
+        memcpy(out + n, d, 4);      // Copy a full entry: cheaper than a variable length
+        n += d[3];
+        out[n++] = '.';
+    }
+    out[--n] = '\0';
+    return n;
+}
+
+inline size_t
+format_ipv4(const in_addr& addr, char* out)
+{
+    return format_ipv4(addr.s_addr, out);
+}
+
+// Out must hold IPV6_STRLEN chars. RFC 5952 zero compression is left to inet_ntop.
+inline size_t
+format_ipv6(const in6_addr& addr, char* out)
+{
+    if (inet_ntop(AF_INET6, &addr, out, IPV6_STRLEN) == nullptr) {
+        out[0] = '\0';
+        return 0;
+    }
+    return strlen(out);
+}
+
+}
+
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef _FRAMED_STREAM_HPP_
+#define _FRAMED_STREAM_HPP_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <span>
+#include <system_error>
+#include <vector>
+#include <sys/uio.h>
+#include "socket.hpp"
+
+namespace npl {
+
+// Message framing over a stream socket. Input is read into one buffer,
+// as much as is available per read, and complete frames are handed out as
+// views into it: many pipelined frames per system call and no allocation
+// per frame. The buffer is compacted when it runs out of room and grows
+// (up to max_frame) only for frames larger than itself.
+//
+// Framing is either a big-endian length prefix of 1, 2 or 4 bytes, or a
+// delimiter byte ending each frame. Frames returned by next() exclude the
+// prefix or delimiter and stay valid until the next fill() / read_frame().
+
+template<int F, int type>
+class framed_stream {
+public:
+    struct framing {
+        unsigned prefix = 2;            // Length prefix bytes, 0 for delimiter framing
+        std::byte delimiter{'\n'};
+    };
+
+    static framing length_prefix(unsigned bytes = 2)
+    {
+        return framing{bytes, std::byte{0}};
+    }
+
+    static framing delimited(char delim = '\n')
+    {
+        return framing{0, std::byte(delim)};
+    }
+
+private:
+    const socket<F,type>& _sock;
+    framing _framing;
+    size_t _max_frame;
+    std::vector<std::byte> _buf;
+    size_t _head = 0;                   // First unconsumed byte
+    size_t _tail = 0;                   // End of valid data
+    size_t _scanned = 0;                // Delimiter search resumes here
+    size_t _need = 0;                   // Bytes still missing from a known-length frame
+
+    size_t header_len(size_t payload) const
+    {
+        if (_framing.prefix < 4 && (payload >> (8 * _framing.prefix)) != 0) {
+            throw std::system_error(EMSGSIZE, std::generic_category(), "framed_stream: frame too large");
+        }
+        return _framing.prefix;
+    }
+
+    void put_header(std::byte* p, size_t payload) const
+    {
+        for (unsigned i = 0; i < _framing.prefix; ++i)
+            p[i] = std::byte((payload >> (8 * (_framing.prefix - 1 - i))) & 0xff);
+    }
+
+    // Room for at least need bytes after _tail
+    void reserve(size_t need)
+    {
+        if (_buf.size() - _tail >= need)
+            return;
+        if (_head > 0) {                // Compact: move the partial frame to the front
+            std::memmove(_buf.data(), _buf.data() + _head, _tail - _head);
+            _scanned -= _head;
+            _tail -= _head;
+            _head = 0;
+        }
+        if (_buf.size() - _tail < need) {
+            _buf.resize(std::max(_buf.size() * 2, _tail + need));
+        }
+    }
+
+public:
+    framed_stream(const socket<F,type>& sock, framing f = framing{}, size_t max_frame = 1 << 20, size_t initial = 1 << 16)
+    : _sock(sock)
+    , _framing(f)
+    , _max_frame(max_frame)
+    , _buf(initial)
+    {
+        if (f.prefix != 0 && f.prefix != 1 && f.prefix != 2 && f.prefix != 4) {
+            throw std::invalid_argument("framed_stream: prefix must be 0, 1, 2 or 4 bytes");
+        }
+    }
+
+    // Next complete frame already buffered, or nullopt if more input is needed
+    std::optional<std::span<const std::byte>> next()
+    {
+        const std::byte* data = _buf.data();
+        size_t avail = _tail - _head;
+
+        if (_framing.prefix == 0) {
+            auto begin = data + std::max(_head, _scanned);
+            auto end = std::find(begin, data + _tail, _framing.delimiter);
+            if (end == data + _tail) {
+                _scanned = _tail;
+                if (avail > _max_frame) {
+                    throw std::system_error(EMSGSIZE, std::generic_category(), "framed_stream: frame too large");
+                }
+                return std::nullopt;
+            }
+            std::span<const std::byte> frame(data + _head, end - (data + _head));
+            _head = (end - data) + 1;
+            _scanned = _head;
+            return frame;
+        }
+
+        if (avail < _framing.prefix)
+            return std::nullopt;
+        size_t len = 0;
+        for (unsigned i = 0; i < _framing.prefix; ++i)
+            len = (len << 8) | std::to_integer<size_t>(data[_head + i]);
+        if (len > _max_frame) {
+            throw std::system_error(EMSGSIZE, std::generic_category(), "framed_stream: frame too large");
+        }
+        if (avail < _framing.prefix + len) {
+            _need = _framing.prefix + len - avail;         // fill() makes room for it
+            return std::nullopt;
+        }
+        std::span<const std::byte> frame(data + _head + _framing.prefix, len);
+        _head += _framing.prefix + len;
+        return frame;
+    }
+
+    // One read into the free space: io_result.bytes == 0 is EOF. Blocks only
+    // if the socket does. Invalidates the frames returned so far.
+    io_result fill()
+    {
+        if (_head == _tail) {
+            _head = _tail = _scanned = 0;
+        }
+        reserve(std::max<size_t>({_need, _buf.size() / 4, 4096}));
+        _need = 0;
+        auto r = _sock.try_read(std::span(_buf).subspan(_tail));
+        if (r.ok())
+            _tail += r.bytes;
+        return r;
+    }
+
+    // Blocking convenience: the next frame, reading as needed; nullopt on
+    // EOF (or error, with errno set)
+    std::optional<std::span<const std::byte>> read_frame()
+    {
+        for (;;) {
+            if (auto f = next())
+                return f;
+            auto r = fill();
+            if ((r.ok() && r.bytes > 0) || r.error == EINTR)
+                continue;
+            errno = r.error;            // 0 at EOF
+            return std::nullopt;
+        }
+    }
+
+    // Bytes received but not yet returned as frames
+    size_t buffered() const
+    {
+        return _tail - _head;
+    }
+
+    size_t capacity() const
+    {
+        return _buf.size();
+    }
+
+    // Append payload as one frame to out, e.g. to pipeline several requests
+    // in one write
+    void append_frame(buffer& out, std::span<const std::byte> payload) const
+    {
+        size_t pos = out.size();
+        if (_framing.prefix == 0) {
+            out.resize(pos + payload.size() + 1);
+            std::memcpy(out.data() + pos, payload.data(), payload.size());
+            out.back() = std::to_integer<uint8_t>(_framing.delimiter);
+            return;
+        }
+        size_t h = header_len(payload.size());
+        out.resize(pos + h + payload.size());
+        put_header(reinterpret_cast<std::byte*>(out.data() + pos), payload.size());
+        std::memcpy(out.data() + pos + h, payload.data(), payload.size());
+    }
+
+    // Send payload as one frame: header (or delimiter) and payload in one writev
+    std::ptrdiff_t write_frame(std::span<const std::byte> payload) const
+    {
+        std::byte hdr[4];
+        size_t h = 1;
+        if (_framing.prefix == 0) {
+            hdr[0] = _framing.delimiter;
+        } else {
+            h = header_len(payload.size());
+            put_header(hdr, payload.size());
+        }
+        iovec iov[2];
+        if (_framing.prefix == 0) {
+            iov[0] = as_iovec(payload);
+            iov[1] = as_iovec(std::span<const std::byte>(hdr, h));
+        } else {
+            iov[0] = as_iovec(std::span<const std::byte>(hdr, h));
+            iov[1] = as_iovec(payload);
+        }
+        return _sock.writevn(iov);
+    }
+};
+
+}
+
+
+#endif
@@ -5,6 +5,7 @@
 #include <system_error>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <algorithm>
 #include <cstdint>
@@ -12,16 +13,19 @@
 #include <net/ethernet.h>
 #include <net/if_arp.h>
 #include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/icmp6.h>
 #include <netinet/in.h>
 #include <netinet/ip_icmp.h>
 #include <netinet/udp.h>
 #include <netinet/tcp.h>
 #include <unordered_map>
 #include <vector>
+#include "format.hpp"
 #include "socket.hpp"
 
 
-enum class hdr {ether, vlan, arp, ipv4, ipv6, icmp, udp, tcp, unkown};
+enum class hdr {ether, vlan, arp, ipv4, ipv6, icmp, icmp6, udp, tcp, unkown};
 
 //constexpr const char * const PROTOCOL_NAME[] = {
 //    "Ether",
@@ -42,6 +46,7 @@ const std::unordered_map<hdr, const std::string> PROTOCOL_NAME =
         {hdr::ipv4,  "IPv4"},
         {hdr::ipv6,  "IPv6"},
         {hdr::icmp,  "ICMP"},
+        {hdr::icmp6, "ICMPv6"},
         {hdr::udp,   "UDP"},
         {hdr::tcp,   "TCP"},
     }; 
@@ -95,19 +100,29 @@ namespace npl {
         std::string 
         src_mac() const
         {
-            std::stringstream ss;
-            ss << std::hex << static_cast<uint16_t>( _ptr->ether_shost[0] );
-            std::for_each(std::begin(_ptr->ether_shost)+1, std::end(_ptr->ether_shost), [&ss](uint8_t x) { ss << ":" << std::hex << static_cast<uint16_t>(x); } ) ;
-            return ss.str();
+            char mac[MAC_STRLEN];
+            return std::string(mac, format_mac(_ptr->ether_shost, mac));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        src_mac(char (&buf)[MAC_STRLEN]) const
+        {
+            return std::string_view(buf, format_mac(_ptr->ether_shost, buf));
         }
 
         std::string 
         dst_mac() const
         {
-            std::stringstream ss;
-            ss << std::hex << static_cast<uint16_t>( _ptr->ether_dhost[0] );
-            std::for_each(std::begin(_ptr->ether_dhost)+1, std::end(_ptr->ether_dhost), [&ss](uint8_t x) { ss << ":" << std::hex << static_cast<uint16_t>(x); } ) ;
-            return ss.str();
+            char mac[MAC_STRLEN];
+            return std::string(mac, format_mac(_ptr->ether_dhost, mac));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        dst_mac(char (&buf)[MAC_STRLEN]) const
+        {
+            return std::string_view(buf, format_mac(_ptr->ether_dhost, buf));
         }
     };
 
@@ -158,19 +173,29 @@ namespace npl {
         std::string 
         src_mac() const
         {
-            std::stringstream ss;
-            ss << std::hex << static_cast<uint16_t>( _ptr->vlan_shost[0] );
-            std::for_each(std::begin(_ptr->vlan_shost)+1, std::end(_ptr->vlan_shost), [&ss](uint8_t x) { ss << ":" << std::hex << static_cast<uint16_t>(x); } ) ;
-            return ss.str();
+            char mac[MAC_STRLEN];
+            return std::string(mac, format_mac(_ptr->vlan_shost, mac));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        src_mac(char (&buf)[MAC_STRLEN]) const
+        {
+            return std::string_view(buf, format_mac(_ptr->vlan_shost, buf));
         }
 
         std::string 
         dst_mac() const
         {
-            std::stringstream ss;
-            ss << std::hex << static_cast<uint16_t>( _ptr->vlan_dhost[0] );
-            std::for_each(std::begin(_ptr->vlan_dhost)+1, std::end(_ptr->vlan_dhost), [&ss](uint8_t x) { ss << ":" << std::hex << static_cast<uint16_t>(x); } ) ;
-            return ss.str();
+            char mac[MAC_STRLEN];
+            return std::string(mac, format_mac(_ptr->vlan_dhost, mac));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        dst_mac(char (&buf)[MAC_STRLEN]) const
+        {
+            return std::string_view(buf, format_mac(_ptr->vlan_dhost, buf));
         }
 
     };
@@ -281,17 +306,29 @@ namespace npl {
         std::string
         src() const
         {
-            char addr[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, reinterpret_cast<const void*>(&_ptr->ip_src.s_addr), addr, sizeof(addr));
-            return addr;
+            char addr[IPV4_STRLEN];
+            return std::string(addr, format_ipv4(_ptr->ip_src, addr));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        src(char (&buf)[IPV4_STRLEN]) const
+        {
+            return std::string_view(buf, format_ipv4(_ptr->ip_src, buf));
         }
 
         std::string
         dst() const
         {
-            char addr[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, reinterpret_cast<const void*>(&_ptr->ip_dst.s_addr), addr, sizeof(addr));
-            return addr;
+            char addr[IPV4_STRLEN];
+            return std::string(addr, format_ipv4(_ptr->ip_dst, addr));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        dst(char (&buf)[IPV4_STRLEN]) const
+        {
+            return std::string_view(buf, format_ipv4(_ptr->ip_dst, buf));
         }
 
         auto
@@ -319,6 +356,154 @@ namespace npl {
 
     };
 
+    // Specialize for IPv6 (fixed header only: see ipv6_skip_ext for the extension chain)
+
+    template<>
+    class header<hdr::ipv6> {
+    private:
+        const struct ip6_hdr* _ptr;
+
+    public:
+        header(const uint8_t* ptr, uint16_t len)
+        : _ptr(reinterpret_cast<const ip6_hdr*>(ptr))
+        {
+            if ( (ptr == nullptr) || (len < sizeof(struct ip6_hdr)) )
+            {
+                throw std::system_error(errno, std::system_category(), "Packet fragment too short");
+            }
+        }
+
+        header  (header const& rhs) = default;
+        header& operator= (header const &) = default;
+        header  (header&& rhs) = default;
+        header& operator=(header &&) = default;
+        ~header() = default;
+
+        auto
+        c_hdr() const
+        {
+            return *(_ptr);
+        }
+
+        unsigned short
+        version() const
+        {
+            return static_cast<unsigned short>(_ptr->ip6_vfc >> 4);
+        }
+
+        unsigned short
+        traffic_class() const
+        {
+            return static_cast<unsigned short>((ntohl(_ptr->ip6_flow) >> 20) & 0xff);
+        }
+
+        u_int32_t
+        flow_label() const
+        {
+            return ntohl(_ptr->ip6_flow) & 0xfffff;
+        }
+
+        u_short
+        payload_len() const
+        {
+            return ntohs(_ptr->ip6_plen);
+        }
+
+        // Next Header of the fixed header: may be an extension header
+        unsigned short
+        next_header() const
+        {
+            return static_cast<unsigned short>(_ptr->ip6_nxt);
+        }
+
+        unsigned short
+        hop_limit() const
+        {
+            return static_cast<unsigned short>(_ptr->ip6_hlim);
+        }
+
+        const in6_addr&
+        src_addr() const
+        {
+            return _ptr->ip6_src;
+        }
+
+        const in6_addr&
+        dst_addr() const
+        {
+            return _ptr->ip6_dst;
+        }
+
+        std::string
+        src() const
+        {
+            char addr[IPV6_STRLEN];
+            return std::string(addr, format_ipv6(_ptr->ip6_src, addr));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        src(char (&buf)[IPV6_STRLEN]) const
+        {
+            return std::string_view(buf, format_ipv6(_ptr->ip6_src, buf));
+        }
+
+        std::string
+        dst() const
+        {
+            char addr[IPV6_STRLEN];
+            return std::string(addr, format_ipv6(_ptr->ip6_dst, addr));
+        }
+
+        // Formats into buf, no allocation
+        std::string_view
+        dst(char (&buf)[IPV6_STRLEN]) const
+        {
+            return std::string_view(buf, format_ipv6(_ptr->ip6_dst, buf));
+        }
+    };
+
+    // Walk the IPv6 extension headers (hop-by-hop, routing, fragment,
+    // destination options) that start at ptr, len bytes available, with nxt
+    // the Next Header of the fixed header. At most max_ext headers are
+    // skipped. Returns the number of bytes skipped and leaves in nxt the
+    // upper-layer protocol, or IPPROTO_NONE if the chain is truncated, too
+    // long, or this is a non-first fragment (no upper-layer header).
+    inline u_int16_t
+    ipv6_skip_ext(const u_int8_t* ptr, u_int16_t len, u_int8_t& nxt, unsigned max_ext = 8)
+    {
+        size_t offset = 0;                      // Never past len: len - offset does not wrap
+        for (unsigned i = 0; i < max_ext; ++i)
+        {
+            u_int16_t ext_len;
+            switch (nxt) {
+                case IPPROTO_HOPOPTS:
+                case IPPROTO_ROUTING:
+                case IPPROTO_DSTOPTS:
+                {
+                    if (len - offset < 2) { nxt = IPPROTO_NONE; return offset; }
+                    ext_len = (ptr[offset + 1] + 1) << 3;
+                    break;
+                }
+                case IPPROTO_FRAGMENT:
+                {
+                    if (len - offset < sizeof(ip6_frag)) { nxt = IPPROTO_NONE; return offset; }
+                    auto frag = reinterpret_cast<const ip6_frag*>(ptr + offset);
+                    if ((frag->ip6f_offlg & IP6F_OFF_MASK) != 0) { nxt = IPPROTO_NONE; return offset; }
+                    ext_len = sizeof(ip6_frag);
+                    break;
+                }
+                default:
+                    return offset;
+            }
+            if (ext_len > len - offset) { nxt = IPPROTO_NONE; return offset; }
+            nxt = ptr[offset];
+            offset += ext_len;
+        }
+        nxt = IPPROTO_NONE;
+        return offset;
+    }
+
     template<>
     class header<hdr::udp> {
     private:
@@ -492,6 +677,48 @@ namespace npl {
         }
     };
 
+
+    // Specialize for ICMPv6 header
+
+    template<>
+    class header<hdr::icmp6> {
+    private:
+        const struct icmp6_hdr* _ptr;
+
+    public:
+        header(const u_char* ptr, ssize_t size)
+        : _ptr(reinterpret_cast<const icmp6_hdr*>(ptr))
+        {
+            if ( (ptr == nullptr) || (size < static_cast<ssize_t>(sizeof(icmp6_hdr))) ) {
+                throw ( std::system_error(errno,std::system_category(),"Packet fragment too short") );
+            }
+        }
+
+        header  (header const& rhs) = default;
+        header& operator= (header const &) = default;
+        header  (header&& rhs) = default;
+        header& operator=(header &&) = default;
+        ~header() = default;
+
+        unsigned short
+        type() const
+        {
+            return _ptr->icmp6_type;
+        }
+
+        auto
+        c_hdr() const
+        {
+            return *_ptr;
+        }
+
+        unsigned short
+        code() const
+        {
+            return _ptr->icmp6_code;
+        }
+    };
+
 }
 
 
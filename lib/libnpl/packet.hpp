@@ -5,20 +5,40 @@
 #include <net/ethernet.h>
 #include <net/if_arp.h>
 #include <netinet/in.h>
+#include <netinet/ip6.h>
+#include <netinet/icmp6.h>
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
+#include <array>
+#include <optional>
+#include <span>
 #include <sys/types.h>
 #include <utility>
-#include <vector>
 
 namespace npl {
 
+    // Parsed layers live in a fixed-capacity inline array: parsing a frame
+    // never touches the heap. Parsing stops once max_layers are recorded.
+
     template <hdr h>
     class packet {
+    public:
+        static constexpr size_t max_layers = 8;
+
     private:
         const u_int8_t* _base;
         u_int16_t _length;
-        std::vector<std::pair<hdr,u_int16_t>> _protocols;
+        u_int8_t  _depth = 0;
+        u_int8_t  _l4_proto = 0;
+        std::array<std::pair<hdr,u_int16_t>, max_layers> _protocols;
+
+        bool push(hdr proto, u_int16_t offset)
+        {
+            if (_depth == max_layers)
+                return false;
+            _protocols[_depth++] = std::make_pair(proto, offset);
+            return true;
+        }
 
     public:
         packet(const u_int8_t* ptr, u_int16_t caplen)
@@ -48,7 +68,7 @@ namespace npl {
                                 break;
                             } 
 
-                            _protocols.push_back(std::make_pair(current_proto, offset));
+                            if (!push(current_proto, offset)) return;
                             offset += hdr_size;
                             caplen = _length - offset;
 
@@ -57,6 +77,11 @@ namespace npl {
                                 break;
                             } 
 
+                            if (hdr_ptr->ether_type == ntohs(ETHERTYPE_IPV6)) {
+                                next_hdr = hdr::ipv6;
+                                break;
+                            } 
+
                             if (hdr_ptr->ether_type == ntohs(ETHERTYPE_ARP)) {
                                 next_hdr = hdr::arp;
                                 break;
@@ -76,7 +101,7 @@ namespace npl {
                             
                             auto hdr_ptr = reinterpret_cast<const vlan_header*>(current_ptr);
 
-                            _protocols.push_back(std::make_pair(current_proto, offset));
+                            if (!push(current_proto, offset)) return;
                             offset += hdr_size;
                             caplen = _length - offset;
 
@@ -85,6 +110,11 @@ namespace npl {
                                 break;
                             } 
 
+                            if (hdr_ptr->ether_type == ntohs(ETHERTYPE_IPV6)) {
+                                next_hdr = hdr::ipv6;
+                                break;
+                            } 
+
                             if (hdr_ptr->ether_type == ntohs(ETHERTYPE_ARP)) {
                                 next_hdr = hdr::arp;
                                 break;
@@ -102,10 +132,8 @@ namespace npl {
 
                             if ((current_ptr == nullptr) || (caplen < hdr_size))
                                 return;
-                            
-                            auto hdr_ptr = reinterpret_cast<const arphdr*>(current_ptr);
 
-                            _protocols.push_back(std::make_pair(current_proto, offset));
+                            if (!push(current_proto, offset)) return;
                             offset += hdr_size;
                             caplen = _length - offset;
 
@@ -124,8 +152,15 @@ namespace npl {
                             
                             auto hdr_ptr = reinterpret_cast<const ip*>(current_ptr);
 
-                            _protocols.push_back(std::make_pair(current_proto, offset));
+                            if (!push(current_proto, offset)) return;
+
+                            // Non-first fragments carry no L4 header
+                            if (ntohs(hdr_ptr->ip_off) & IP_OFFMASK)
+                                return;
+                            _l4_proto = hdr_ptr->ip_p;
+
                             auto iphl = (hdr_ptr->ip_hl << 2);
+                            if (iphl < hdr_size || iphl > caplen) return;
                             offset += iphl;
                             caplen = _length - offset;
 
@@ -158,6 +193,54 @@ namespace npl {
                             break;
                         }      
 
+                        case hdr::ipv6: 
+                        {
+                            auto current_ptr = _base + offset;
+                            auto hdr_size = sizeof(ip6_hdr);
+                            auto current_proto = hdr::ipv6;
+
+                            if ((current_ptr == nullptr) || (caplen < hdr_size))
+                                return;
+                            
+                            auto hdr_ptr = reinterpret_cast<const ip6_hdr*>(current_ptr);
+
+                            if (!push(current_proto, offset)) return;
+                            offset += hdr_size;
+                            caplen = _length - offset;
+
+                            // Extension headers are skipped, not recorded as layers
+                            u_int8_t nxt = hdr_ptr->ip6_nxt;
+                            offset += ipv6_skip_ext(_base + offset, caplen, nxt);
+                            caplen = _length - offset;
+                            _l4_proto = (nxt == IPPROTO_NONE) ? 0 : nxt;
+
+                            switch (nxt) {
+                                case IPPROTO_ICMPV6:
+                                {
+                                    next_hdr = hdr::icmp6;
+                                    break;
+                                }
+
+                                case IPPROTO_UDP:
+                                {
+                                    next_hdr = hdr::udp;
+                                    break;
+                                }
+
+                                case IPPROTO_TCP:
+                                {
+                                    next_hdr = hdr::tcp;
+                                    break;
+                                }
+                                default:
+                                {
+                                    next_hdr = hdr::unkown;
+                                    break;
+                                }
+                            }
+                            break;
+                        }      
+
                         case hdr::udp: {
                             auto current_ptr = _base + offset;
                             auto hdr_size = sizeof(udphdr);
@@ -165,11 +248,10 @@ namespace npl {
 
                             if (current_ptr == nullptr || caplen < hdr_size) return;
 
-                            _protocols.push_back(std::make_pair(current_proto, offset));
+                            if (!push(current_proto, offset)) return;
                             offset += hdr_size; 
                             caplen = _length - offset;
 
-                            auto hdr_ptr = reinterpret_cast<const udphdr*>(current_ptr);
                             next_hdr = hdr::unkown;
                             break;
                         }
@@ -182,8 +264,9 @@ namespace npl {
                             if (current_ptr == nullptr || caplen < hdr_size) return;
 
                             auto hdr_ptr = reinterpret_cast<const tcphdr*>(current_ptr);
-                            _protocols.push_back(std::make_pair(current_proto, offset));
-                            auto tcphl = (hdr_ptr->th_off << 2);
+                            if (!push(current_proto, offset)) return;
+                            auto tcphl = static_cast<size_t>(hdr_ptr->th_off << 2);
+                            if (tcphl < hdr_size || tcphl > caplen) return;
                             offset += tcphl; //+ options...
                             caplen = _length - offset;
 
@@ -198,7 +281,22 @@ namespace npl {
 
                             if (current_ptr == nullptr || caplen < hdr_size) return;
 
-                            _protocols.push_back(std::make_pair(current_proto, offset));
+                            if (!push(current_proto, offset)) return;
+                            offset += hdr_size;
+                            caplen = _length - offset;
+                            
+                            next_hdr = hdr::unkown;
+                            break;
+                        }
+                        
+                        case hdr::icmp6: {
+                            auto current_ptr = _base + offset;
+                            auto hdr_size = sizeof(icmp6_hdr);
+                            auto current_proto = hdr::icmp6;
+
+                            if (current_ptr == nullptr || caplen < hdr_size) return;
+
+                            if (!push(current_proto, offset)) return;
                             offset += hdr_size;
                             caplen = _length - offset;
                             
@@ -217,7 +315,7 @@ namespace npl {
         packet(const packet&) = default;
         packet& operator=(const packet&) = default;
         packet(packet&& ) = default;
-        packet& operator=(packet&) = default;
+        packet& operator=(packet&&) = default;
         ~packet() = default;
 
         
@@ -226,7 +324,7 @@ namespace npl {
         auto has() const
         {
             int out = 0;
-            for (auto &x : _protocols)
+            for (auto &x : this->dump())
             {
                 if (x.first == proto) 
                     ++out;
@@ -234,23 +332,29 @@ namespace npl {
             return out;
         }
 
-        // returns proto headers
+        // Returns the n-th header of type proto (the outermost by default), if any
         template<hdr proto>
-        auto get() const 
+        std::optional<header<proto>> get(unsigned n = 0) const 
         {
-            std::vector<header<proto>> out;
-            for (auto &x : _protocols)
+            for (auto &x : this->dump())
             {
-                if (x.first == proto) 
-                    out.push_back(header<proto>(_base+x.second,_length-x.second));
+                if (x.first == proto && n-- == 0) 
+                    return header<proto>(_base+x.second,_length-x.second);
             }
-            return out;
+            return std::nullopt;
         }
 
-        // Returns the whole sequence of headers
-        auto dump() const 
+        // Upper-layer protocol number of the IPv4/IPv6 packet, after any IPv6
+        // extension headers; 0 without IP and for non-first fragments
+        u_int8_t l4_proto() const
         {
-            return _protocols;
+            return _l4_proto;
+        }
+
+        // Returns the whole sequence of headers (a view on the packet)
+        std::span<const std::pair<hdr,u_int16_t>> dump() const 
+        {
+            return std::span<const std::pair<hdr,u_int16_t>>(_protocols.data(), _depth);
         }
 
         void display() const
@@ -258,12 +362,16 @@ namespace npl {
             // for (auto &x : _protocols) std::cout << PROTOCOL_NAME.at(x.first) << "  ";
             // std::cout << std::endl;
 
+            if (_depth == 0)
+                return;
+
             auto print = [](auto p) {
                 std::cout << PROTOCOL_NAME.at(p.first) << "--";
             };
 
-            std::for_each(_protocols.begin(), _protocols.end()-1, print);
-            std::cout << PROTOCOL_NAME.at(_protocols.back().first);
+            auto layers = this->dump();
+            std::for_each(layers.begin(), layers.end()-1, print);
+            std::cout << PROTOCOL_NAME.at(layers.back().first);
         }
     };
 
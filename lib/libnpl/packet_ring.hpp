@@ -0,0 +1,261 @@
+#ifndef _PACKET_RING_HPP_
+#define _PACKET_RING_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <system_error>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <linux/if_packet.h>
+#include "socket.hpp"
+
+namespace npl {
+
+// PACKET_MMAP TPACKET_V3 receive ring on an AF_PACKET socket. The kernel
+// fills fixed-size blocks with variable-size frames and retires a block
+// when it is full or its timeout expires; the whole block is then handed to
+// the caller in place (no copies, no per-packet system calls) and given back
+// to the kernel once walked.
+//
+// Set the ring up before binding the socket to an interface.
+
+class packet_ring {
+public:
+    // One captured frame, pointing into the ring
+    class frame {
+    private:
+        const tpacket3_hdr* _hdr;
+
+    public:
+        explicit frame(const tpacket3_hdr* hdr)
+        : _hdr(hdr)
+        {}
+
+        const u_int8_t* data() const
+        {
+            return reinterpret_cast<const u_int8_t*>(_hdr) + _hdr->tp_mac;
+        }
+
+        u_int32_t caplen() const
+        {
+            return _hdr->tp_snaplen;
+        }
+
+        u_int32_t len() const
+        {
+            return _hdr->tp_len;
+        }
+
+        u_int32_t sec() const
+        {
+            return _hdr->tp_sec;
+        }
+
+        u_int32_t nsec() const
+        {
+            return _hdr->tp_nsec;
+        }
+
+        u_int32_t rxhash() const
+        {
+            return _hdr->hv1.tp_rxhash;
+        }
+
+        const tpacket3_hdr& c_hdr() const
+        {
+            return *_hdr;
+        }
+    };
+
+    // A block retired by the kernel: a forward range of frames
+    class block {
+    private:
+        const tpacket_block_desc* _desc;
+
+    public:
+        class iterator {
+        private:
+            const tpacket3_hdr* _hdr;
+            u_int32_t _left;
+
+        public:
+            iterator(const tpacket3_hdr* hdr, u_int32_t left)
+            : _hdr(hdr), _left(left)
+            {}
+
+            frame operator*() const
+            {
+                return frame(_hdr);
+            }
+
+            iterator& operator++()
+            {
+                if (--_left > 0) {
+                    _hdr = reinterpret_cast<const tpacket3_hdr*>(reinterpret_cast<const u_int8_t*>(_hdr) + _hdr->tp_next_offset);
+                }
+                return *this;
+            }
+
+            bool operator==(const iterator& rhs) const
+            {
+                return _left == rhs._left;
+            }
+        };
+
+        explicit block(const tpacket_block_desc* desc)
+        : _desc(desc)
+        {}
+
+        u_int32_t size() const
+        {
+            return _desc->hdr.bh1.num_pkts;
+        }
+
+        iterator begin() const
+        {
+            auto first = reinterpret_cast<const u_int8_t*>(_desc) + _desc->hdr.bh1.offset_to_first_pkt;
+            return iterator(reinterpret_cast<const tpacket3_hdr*>(first), size());
+        }
+
+        iterator end() const
+        {
+            return iterator(nullptr, 0);
+        }
+    };
+
+private:
+    int _fd;
+    tpacket_req3 _req;
+    u_int8_t* _map = nullptr;
+    size_t _map_sz = 0;
+    unsigned _current = 0;
+
+    tpacket_block_desc* desc(unsigned i) const
+    {
+        return reinterpret_cast<tpacket_block_desc*>(_map + static_cast<size_t>(i) * _req.tp_block_size);
+    }
+
+public:
+    // block_size must be a multiple of the page size, frame_size a multiple of
+    // TPACKET_ALIGNMENT; block timeout_ms bounds the latency at low rates
+    explicit packet_ring(socket<AF_PACKET, SOCK_RAW>& sock,
+                         unsigned block_size = 1 << 22,
+                         unsigned block_nr   = 64,
+                         unsigned frame_size = 2048,
+                         unsigned timeout_ms = 60)
+    : _fd(sock.fd())
+    {
+        int version = TPACKET_V3;
+        sock.setsockopt(SOL_PACKET, PACKET_VERSION, &version, sizeof(version));
+
+        memset(&_req, 0, sizeof(_req));
+        _req.tp_block_size = block_size;
+        _req.tp_block_nr   = block_nr;
+        _req.tp_frame_size = frame_size;
+        _req.tp_frame_nr   = (block_size / frame_size) * block_nr;
+        _req.tp_retire_blk_tov = timeout_ms;
+        _req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+        sock.setsockopt(SOL_PACKET, PACKET_RX_RING, &_req, sizeof(_req));
+
+        _map_sz = static_cast<size_t>(block_size) * block_nr;
+        void* map = ::mmap(nullptr, _map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED | MAP_POPULATE, _fd, 0);
+        if (map == MAP_FAILED) {
+            // MAP_LOCKED fails without CAP_IPC_LOCK / a large enough RLIMIT_MEMLOCK
+            map = ::mmap(nullptr, _map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, 0);
+        }
+        if (map == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "packet_ring mmap");
+        }
+        _map = static_cast<u_int8_t*>(map);
+    }
+
+    packet_ring(const packet_ring&) = delete;
+    packet_ring& operator=(const packet_ring&) = delete;
+
+    packet_ring(packet_ring&& rhs)
+    : _fd(rhs._fd), _req(rhs._req), _map(rhs._map), _map_sz(rhs._map_sz), _current(rhs._current)
+    {
+        rhs._map = nullptr;
+    }
+
+    ~packet_ring()
+    {
+        if (_map != nullptr) {
+            ::munmap(_map, _map_sz);
+        }
+    }
+
+    unsigned block_nr() const
+    {
+        return _req.tp_block_nr;
+    }
+
+    // True if the next block has been retired by the kernel
+    bool ready() const
+    {
+        auto status = std::atomic_ref<u_int32_t>(desc(_current)->hdr.bh1.block_status).load(std::memory_order_acquire);
+        return status & TP_STATUS_USER;
+    }
+
+    // Wait up to timeout_ms (-1: forever) for the next block. Returns false on timeout.
+    bool wait(int timeout_ms = -1) const
+    {
+        if (ready())
+            return true;
+
+        pollfd pfd = {_fd, POLLIN | POLLERR, 0};
+        if (::poll(&pfd, 1, timeout_ms) == -1 && errno != EINTR) {
+            throw std::system_error(errno, std::system_category(), "packet_ring poll");
+        }
+        return ready();
+    }
+
+    // The next block; valid until release()
+    block next() const
+    {
+        return block(desc(_current));
+    }
+
+    // Hand the current block back to the kernel and move to the next one
+    void release()
+    {
+        std::atomic_ref<u_int32_t>(desc(_current)->hdr.bh1.block_status).store(TP_STATUS_KERNEL, std::memory_order_release);
+        _current = (_current + 1) % _req.tp_block_nr;
+    }
+
+    // Wait for a block, call func(frame) on each of its frames, release it.
+    // Returns the number of frames processed.
+    template<typename F>
+    unsigned dispatch(F&& func, int timeout_ms = -1)
+    {
+        if (!wait(timeout_ms))
+            return 0;
+        auto blk = next();
+        unsigned n = 0;
+        for (auto f : blk) {
+            func(f);
+            ++n;
+        }
+        release();
+        return n;
+    }
+
+    // Kernel counters since the last call (reading them resets them)
+    tpacket_stats_v3 stats() const
+    {
+        tpacket_stats_v3 st = {};
+        socklen_t len = sizeof(st);
+        if (::getsockopt(_fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == -1) {
+            throw std::system_error(errno, std::system_category(), "packet_ring stats");
+        }
+        return st;
+    }
+};
+
+}
+
+
+#endif
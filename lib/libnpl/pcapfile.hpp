@@ -0,0 +1,525 @@
+#ifndef _PCAPFILE_HPP_
+#define _PCAPFILE_HPP_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <byteswap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Native pcap file support (writer and memory-mapped reader): no libpcap
+// needed, unlike pcap.hpp
+
+namespace npl::pcap {
+
+    constexpr u_int32_t MAGIC_USEC = 0xa1b2c3d4;
+    constexpr u_int32_t MAGIC_NSEC = 0xa1b23c4d;
+    constexpr u_int32_t LINKTYPE_ETHERNET = 1;
+
+    struct file_header {
+        u_int32_t magic;
+        u_int16_t version_major;
+        u_int16_t version_minor;
+        int32_t   thiszone;
+        u_int32_t sigfigs;
+        u_int32_t snaplen;
+        u_int32_t linktype;
+    };
+
+    struct record_header {
+        u_int32_t ts_sec;
+        u_int32_t ts_frac;      // Microseconds or nanoseconds, see the magic
+        u_int32_t caplen;
+        u_int32_t len;
+    };
+
+    static_assert(sizeof(file_header) == 24 && sizeof(record_header) == 16);
+
+    // Classic pcap writer. Records are appended to one large page-aligned
+    // buffer and written out a buffer at a time, so the cost of a packet is
+    // a memcpy; there is no per-packet stdio call. A record that does not fit
+    // is written together with the pending buffer in one writev.
+    //
+    // With direct = true the file is opened O_DIRECT: full pages bypass the
+    // page cache (no write-back bursts, no cache pollution), the partial page
+    // at the tail is kept for the next flush and written through the page
+    // cache only when the file is closed.
+    //
+    // Files rotate after rotate_bytes or rotate_seconds of capture time
+    // (0: never); the n-th file after the first is named path.n.
+    //
+    // pcapng is not implemented: classic pcap is what the rest of the
+    // tooling reads, and it needs no per-block bookkeeping.
+
+    class writer {
+    public:
+        struct options {
+            size_t    buffer_size    = 4 << 20;     // Rounded up to whole pages
+            bool      direct         = false;
+            u_int64_t rotate_bytes   = 0;
+            u_int32_t rotate_seconds = 0;
+            bool      nanosecond     = false;       // Nanosecond timestamps (MAGIC_NSEC)
+            u_int32_t snaplen        = 262144;
+            u_int32_t linktype       = LINKTYPE_ETHERNET;
+        };
+
+    private:
+        static constexpr size_t page = 4096;
+
+        std::string _path;
+        options   _opt;
+        int       _fd = -1;
+        u_int8_t* _buf = nullptr;
+        size_t    _used = 0;
+        u_int64_t _file_bytes = 0;      // Including the buffered part
+        u_int32_t _file_start = 0;      // Capture time of the first record
+        bool      _file_empty = true;
+        unsigned  _index = 0;
+        u_int64_t _packets = 0;
+        u_int64_t _bytes = 0;
+
+        void write_all(iovec* iov, int iovcnt)
+        {
+            while (iovcnt > 0)
+            {
+                auto n = ::writev(_fd, iov, iovcnt);
+                if (n == -1) {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::system_error(errno, std::system_category(), "pcap writer");
+                }
+                // Skip what went out, resume a partially written vector
+                while (iovcnt > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+                    n -= iov->iov_len;
+                    ++iov;
+                    --iovcnt;
+                }
+                if (iovcnt > 0) {
+                    iov->iov_base = static_cast<u_int8_t*>(iov->iov_base) + n;
+                    iov->iov_len -= n;
+                }
+            }
+        }
+
+        // Write out the buffer; with O_DIRECT only whole pages unless final
+        void drain(bool final)
+        {
+            size_t out = (_opt.direct && !final) ? _used & ~(page - 1) : _used;
+            if (out == 0)
+                return;
+
+            if (_opt.direct && final && (out & (page - 1))) {
+                // The unaligned tail cannot go through O_DIRECT
+                ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) & ~O_DIRECT);
+            }
+
+            iovec iov = {_buf, out};
+            write_all(&iov, 1);
+            memmove(_buf, _buf + out, _used - out);
+            _used -= out;
+        }
+
+        std::string file_name() const
+        {
+            return _index == 0 ? _path : _path + "." + std::to_string(_index);
+        }
+
+        void open_file()
+        {
+            int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            if (_opt.direct) {
+                _fd = ::open(file_name().c_str(), flags | O_DIRECT, 0644);
+                if (_fd == -1 && errno != EINVAL)
+                    throw std::system_error(errno, std::system_category(), "pcap writer open " + file_name());
+                if (_fd == -1)
+                    _opt.direct = false;        // Not supported by this file system (e.g. tmpfs)
+            }
+            if (!_opt.direct && (_fd = ::open(file_name().c_str(), flags, 0644)) == -1) {
+                throw std::system_error(errno, std::system_category(), "pcap writer open " + file_name());
+            }
+
+            file_header hdr = {
+                _opt.nanosecond ? MAGIC_NSEC : MAGIC_USEC, 2, 4, 0, 0, _opt.snaplen, _opt.linktype
+            };
+            memcpy(_buf, &hdr, sizeof(hdr));
+            _used = sizeof(hdr);
+            _file_bytes = sizeof(hdr);
+            _file_empty = true;
+        }
+
+        void close_file()
+        {
+            if (_fd == -1)
+                return;
+            drain(true);
+            ::close(_fd);
+            _fd = -1;
+        }
+
+        void rotate()
+        {
+            close_file();
+            ++_index;
+            open_file();
+        }
+
+    public:
+        explicit writer(const std::string& path)
+        : writer(path, options())
+        {}
+
+        writer(const std::string& path, const options& opt)
+        : _path(path), _opt(opt)
+        {
+            _opt.buffer_size = std::max<size_t>((_opt.buffer_size + page - 1) & ~(page - 1), page);
+            if ((_buf = static_cast<u_int8_t*>(std::aligned_alloc(page, _opt.buffer_size))) == nullptr) {
+                throw std::system_error(ENOMEM, std::system_category(), "pcap writer buffer");
+            }
+            try {
+                open_file();
+            }
+            catch (...) {
+                std::free(_buf);
+                throw;
+            }
+        }
+
+        writer(const writer&) = delete;
+        writer& operator=(const writer&) = delete;
+
+        ~writer()
+        {
+            try {
+                close_file();
+            }
+            catch (...) {}
+            std::free(_buf);
+        }
+
+        // Append one record; caplen is cut to the snaplen
+        void write(u_int32_t sec, u_int32_t frac, u_int32_t caplen, u_int32_t len, const u_int8_t* bytes)
+        {
+            caplen = std::min(caplen, _opt.snaplen);
+            size_t rec = sizeof(record_header) + caplen;
+
+            if (!_file_empty) {
+                if ((_opt.rotate_bytes   && _file_bytes + rec > _opt.rotate_bytes) ||
+                    (_opt.rotate_seconds && sec - _file_start >= _opt.rotate_seconds))
+                    rotate();
+            }
+            if (_file_empty) {
+                _file_start = sec;
+                _file_empty = false;
+            }
+
+            record_header hdr = {sec, frac, caplen, len};
+
+            if (_used + rec <= _opt.buffer_size) {
+                memcpy(_buf + _used, &hdr, sizeof(hdr));
+                memcpy(_buf + _used + sizeof(hdr), bytes, caplen);
+                _used += rec;
+            }
+            else if (!_opt.direct) {
+                // Pending buffer, header and packet in one system call
+                iovec iov[3] = {
+                    {_buf, _used},
+                    {&hdr, sizeof(hdr)},
+                    {const_cast<u_int8_t*>(bytes), caplen}
+                };
+                write_all(iov, 3);
+                _used = 0;
+            }
+            else {
+                // O_DIRECT: copy through the buffer, draining whole pages
+                const u_int8_t* src = reinterpret_cast<const u_int8_t*>(&hdr);
+                size_t left = sizeof(hdr);
+                for (int part = 0; part < 2; ++part) {
+                    while (left > 0) {
+                        if (_used == _opt.buffer_size)
+                            drain(false);
+                        size_t n = std::min(left, _opt.buffer_size - _used);
+                        memcpy(_buf + _used, src, n);
+                        _used += n;
+                        src += n;
+                        left -= n;
+                    }
+                    src = bytes;
+                    left = caplen;
+                }
+            }
+
+            _file_bytes += rec;
+            ++_packets;
+            _bytes += rec;
+
+            if (_used == _opt.buffer_size || (_opt.direct && _opt.buffer_size - _used < page))
+                drain(false);
+        }
+
+        // From a pcap_pkthdr-like header (ts as a timeval, caplen, len),
+        // e.g. inside a reader<>::loop callback
+        template<typename H>
+        requires requires (const H& h) { h.ts.tv_sec; h.ts.tv_usec; h.caplen; h.len; }
+        void write(const H* hdr, const u_int8_t* bytes)
+        {
+            u_int32_t frac = _opt.nanosecond ? hdr->ts.tv_usec * 1000 : hdr->ts.tv_usec;
+            write(hdr->ts.tv_sec, frac, hdr->caplen, hdr->len, bytes);
+        }
+
+        // From a frame with sec()/nsec()/caplen()/len()/data(), e.g. packet_ring::frame
+        template<typename Frame>
+        requires requires (const Frame& f) { f.sec(); f.nsec(); f.caplen(); f.len(); f.data(); }
+        void write(const Frame& f)
+        {
+            u_int32_t frac = _opt.nanosecond ? f.nsec() : f.nsec() / 1000;
+            write(f.sec(), frac, f.caplen(), f.len(), f.data());
+        }
+
+        // Hand the buffered records to the kernel (whole pages only with O_DIRECT)
+        void flush()
+        {
+            drain(false);
+        }
+
+        // Flush everything and close the current file; the writer is unusable afterwards
+        void close()
+        {
+            close_file();
+        }
+
+        u_int64_t packets() const
+        {
+            return _packets;
+        }
+
+        u_int64_t bytes() const
+        {
+            return _bytes;
+        }
+
+        unsigned files() const
+        {
+            return _index + 1;
+        }
+
+        std::string current_file() const
+        {
+            return file_name();
+        }
+    };
+
+
+    // One record, pointing into the mapped file. Timestamps are in
+    // nanoseconds whatever the file resolution.
+    struct record {
+        u_int32_t sec;
+        u_int32_t nsec;
+        u_int32_t caplen;
+        u_int32_t len;
+        const u_int8_t* data;
+    };
+
+    // Offline reader that maps the whole file and walks the records in place:
+    // no copy, no per-packet library call. Accepts microsecond and
+    // nanosecond files in either byte order. Offsets are 64-bit and the
+    // mapping is read-only and clean, so files larger than memory work: the
+    // kernel reads ahead (MADV_SEQUENTIAL) and drops pages already walked.
+
+    class mapped_reader {
+    private:
+        int _fd = -1;
+        const u_int8_t* _map = nullptr;
+        size_t _size = 0;
+        size_t _pos = sizeof(file_header);
+        file_header _hdr;
+        bool _swapped = false;
+        bool _nano = false;
+        bool _truncated = false;
+
+        void release()
+        {
+            if (_map != nullptr) {
+                ::munmap(const_cast<u_int8_t*>(_map), _size);
+                _map = nullptr;
+            }
+            if (_fd != -1) {
+                ::close(_fd);
+                _fd = -1;
+            }
+        }
+
+    public:
+        explicit mapped_reader(const std::string& path)
+        {
+            if ((_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC)) == -1) {
+                throw std::system_error(errno, std::system_category(), "pcap open " + path);
+            }
+
+            struct stat st;
+            if (::fstat(_fd, &st) == -1) {
+                int err = errno;
+                ::close(_fd);
+                throw std::system_error(err, std::system_category(), "pcap stat " + path);
+            }
+            _size = st.st_size;
+            if (_size < sizeof(file_header)) {
+                ::close(_fd);
+                throw std::system_error(EINVAL, std::generic_category(), "pcap file too short: " + path);
+            }
+
+            void* map = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (map == MAP_FAILED) {
+                int err = errno;
+                ::close(_fd);
+                throw std::system_error(err, std::system_category(), "pcap mmap " + path);
+            }
+            _map = static_cast<const u_int8_t*>(map);
+            ::madvise(map, _size, MADV_SEQUENTIAL);
+
+            memcpy(&_hdr, _map, sizeof(_hdr));
+            switch (_hdr.magic) {
+                case MAGIC_USEC:            break;
+                case MAGIC_NSEC:            _nano = true; break;
+                case 0xd4c3b2a1:            _swapped = true; break;         // Written on the other endianness
+                case 0x4d3cb2a1:            _swapped = _nano = true; break;
+                default:
+                    release();
+                    throw std::system_error(EINVAL, std::generic_category(), "not a pcap file: " + path);
+            }
+            if (_swapped) {
+                _hdr.version_major = bswap_16(_hdr.version_major);
+                _hdr.version_minor = bswap_16(_hdr.version_minor);
+                _hdr.snaplen  = bswap_32(_hdr.snaplen);
+                _hdr.linktype = bswap_32(_hdr.linktype);
+            }
+            if (_hdr.version_major != 2) {
+                release();
+                throw std::system_error(EINVAL, std::generic_category(), "unsupported pcap version: " + path);
+            }
+        }
+
+        mapped_reader(const mapped_reader&) = delete;
+        mapped_reader& operator=(const mapped_reader&) = delete;
+
+        mapped_reader(mapped_reader&& rhs)
+        : _fd(rhs._fd), _map(rhs._map), _size(rhs._size), _pos(rhs._pos), _hdr(rhs._hdr)
+        , _swapped(rhs._swapped), _nano(rhs._nano), _truncated(rhs._truncated)
+        {
+            rhs._fd = -1;
+            rhs._map = nullptr;
+        }
+
+        ~mapped_reader()
+        {
+            release();
+        }
+
+        u_int32_t linktype() const
+        {
+            return _hdr.linktype;
+        }
+
+        u_int32_t snaplen() const
+        {
+            return _hdr.snaplen;
+        }
+
+        bool nanosecond() const
+        {
+            return _nano;
+        }
+
+        bool swapped() const
+        {
+            return _swapped;
+        }
+
+        // File size and current position (offset of the next record)
+        size_t size() const
+        {
+            return _size;
+        }
+
+        size_t offset() const
+        {
+            return _pos;
+        }
+
+        // The whole file, e.g. to index record boundaries
+        const u_int8_t* data() const
+        {
+            return _map;
+        }
+
+        // True if the walk stopped on an incomplete or corrupt record
+        bool truncated() const
+        {
+            return _truncated;
+        }
+
+        // Continue from a record boundary (offset() of an earlier walk)
+        void seek(size_t offset)
+        {
+            _pos = std::min(std::max(offset, sizeof(file_header)), _size);
+            _truncated = false;
+        }
+
+        // Read the record at offset() and move past it. Returns false at the end.
+        bool next(record& r)
+        {
+            if (_size - _pos < sizeof(record_header)) {
+                _truncated = (_pos != _size);
+                return false;
+            }
+
+            record_header h;
+            memcpy(&h, _map + _pos, sizeof(h));
+            if (_swapped) {
+                h.ts_sec  = bswap_32(h.ts_sec);
+                h.ts_frac = bswap_32(h.ts_frac);
+                h.caplen  = bswap_32(h.caplen);
+                h.len     = bswap_32(h.len);
+            }
+            if (h.caplen > _size - _pos - sizeof(h)) {
+                _truncated = true;
+                return false;
+            }
+
+            r.sec    = h.ts_sec;
+            r.nsec   = _nano ? h.ts_frac : h.ts_frac * 1000;
+            r.caplen = h.caplen;
+            r.len    = h.len;
+            r.data   = _map + _pos + sizeof(h);
+            _pos += sizeof(h) + h.caplen;
+            return true;
+        }
+
+        // Call func(const record&) on every record up to end (a record
+        // boundary, default: end of file). Returns the number of records.
+        template<typename F>
+        size_t loop(F&& func, size_t end = SIZE_MAX)
+        {
+            size_t n = 0;
+            record r;
+            while (_pos < end && next(r)) {
+                func(static_cast<const record&>(r));
+                ++n;
+            }
+            return n;
+        }
+    };
+
+}
+
+
+#endif
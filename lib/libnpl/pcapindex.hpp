@@ -0,0 +1,204 @@
+#ifndef _PCAPINDEX_HPP_
+#define _PCAPINDEX_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include "pcapfile.hpp"
+
+namespace npl::pcap {
+
+    // Record boundaries of a pcap file, one every chunk_size bytes or so,
+    // so that the file can be walked by several threads at once. Building
+    // the index reads every record header (i.e. the whole file once); it can
+    // be saved next to the trace and reused while the trace is unchanged.
+
+    class chunk_index {
+    private:
+        static constexpr u_int64_t magic = 0x31305844494c504eULL;    // "NPLIDX01"
+
+        struct sidecar_header {
+            u_int64_t magic;
+            u_int64_t file_size;
+            int64_t   mtime_ns;
+            u_int64_t chunk_size;
+            u_int64_t count;
+        };
+
+        u_int64_t _file_size = 0;
+        int64_t   _mtime_ns = 0;
+        u_int64_t _chunk_size = 0;
+        std::vector<u_int64_t> _bounds;     // Chunk i is [_bounds[i], _bounds[i+1])
+
+        static std::pair<u_int64_t, int64_t> identity(const std::string& path)
+        {
+            struct stat st;
+            if (::stat(path.c_str(), &st) == -1) {
+                throw std::system_error(errno, std::system_category(), "stat " + path);
+            }
+            return {static_cast<u_int64_t>(st.st_size), st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec};
+        }
+
+    public:
+        chunk_index() = default;
+
+        // Scan the record headers of the file
+        static chunk_index build(const std::string& path, size_t chunk_size = 64 << 20)
+        {
+            chunk_index idx;
+            std::tie(idx._file_size, idx._mtime_ns) = identity(path);
+            idx._chunk_size = chunk_size;
+
+            mapped_reader in(path);
+            idx._bounds.push_back(in.offset());
+            size_t next = in.offset() + chunk_size;
+            record r;
+            while (in.next(r)) {
+                if (in.offset() >= next) {
+                    idx._bounds.push_back(in.offset());
+                    next = in.offset() + chunk_size;
+                }
+            }
+            if (idx._bounds.back() != in.offset())
+                idx._bounds.push_back(in.offset());     // End of the last complete record
+            return idx;
+        }
+
+        // Read a sidecar index; nullopt if missing or stale (trace size or mtime changed)
+        static std::optional<chunk_index> load(const std::string& path, const std::string& index_path)
+        {
+            FILE* f = std::fopen(index_path.c_str(), "rb");
+            if (f == nullptr)
+                return std::nullopt;
+
+            chunk_index idx;
+            sidecar_header h;
+            auto [size, mtime] = identity(path);
+            struct stat st;
+            bool ok = ::fstat(::fileno(f), &st) == 0 && std::fread(&h, sizeof(h), 1, f) == 1 &&
+                      h.magic == magic && h.file_size == size && h.mtime_ns == mtime && h.count >= 1 &&
+                      h.count == (st.st_size - sizeof(h)) / sizeof(u_int64_t);  // Not more than the file holds
+            if (ok) {
+                idx._bounds.resize(h.count);
+                ok = std::fread(idx._bounds.data(), sizeof(u_int64_t), h.count, f) == h.count;
+            }
+            std::fclose(f);
+
+            // Chunk bounds must be increasing and inside the trace
+            for (size_t i = 0; ok && i < idx._bounds.size(); ++i) {
+                ok = idx._bounds[i] <= size && (i == 0 || idx._bounds[i - 1] < idx._bounds[i]);
+            }
+            if (!ok)
+                return std::nullopt;
+
+            idx._file_size = h.file_size;
+            idx._mtime_ns = h.mtime_ns;
+            idx._chunk_size = h.chunk_size;
+            return idx;
+        }
+
+        void save(const std::string& index_path) const
+        {
+            FILE* f = std::fopen(index_path.c_str(), "wb");
+            if (f == nullptr) {
+                throw std::system_error(errno, std::system_category(), "open " + index_path);
+            }
+            sidecar_header h = {magic, _file_size, _mtime_ns, _chunk_size, _bounds.size()};
+            bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+                      std::fwrite(_bounds.data(), sizeof(u_int64_t), _bounds.size(), f) == _bounds.size();
+            if (std::fclose(f) != 0 || !ok) {
+                throw std::system_error(errno, std::system_category(), "write " + index_path);
+            }
+        }
+
+        // The sidecar index path.idx if it is up to date, else scan and save it
+        static chunk_index open(const std::string& path, size_t chunk_size = 64 << 20)
+        {
+            auto index_path = path + ".idx";
+            if (auto idx = load(path, index_path); idx && idx->_chunk_size == chunk_size)
+                return *idx;
+            auto idx = build(path, chunk_size);
+            try {
+                idx.save(index_path);
+            }
+            catch (const std::system_error&) {}     // Read-only directory: just rescan next time
+            return idx;
+        }
+
+        size_t chunks() const
+        {
+            return _bounds.empty() ? 0 : _bounds.size() - 1;
+        }
+
+        u_int64_t begin(size_t i) const
+        {
+            return _bounds[i];
+        }
+
+        u_int64_t end(size_t i) const
+        {
+            return _bounds[i + 1];
+        }
+    };
+
+    // Walk the chunks of a trace on nthreads threads. Each thread owns one
+    // State, built as make_state(thread id), and takes the next chunk from a
+    // shared counter until none is left, calling func(state, record) on each
+    // record. A State with a flush() member has it called at the end of each
+    // chunk, while the records of the chunk are still mapped (e.g. to finish
+    // a partial frame_batch). The states are returned for the caller to
+    // merge. Records of a chunk are visited in order; chunks are not.
+    template<typename MakeState, typename F>
+    auto parallel_walk(const std::string& path, const chunk_index& idx, unsigned nthreads,
+                       MakeState make_state, F func)
+    {
+        using State = decltype(make_state(0u));
+
+        std::vector<std::optional<State>> states(nthreads);
+        std::vector<std::exception_ptr> errors(nthreads);
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+
+        for (unsigned id = 0; id < nthreads; ++id) {
+            workers.emplace_back([&, id]() {
+                try {
+                    states[id].emplace(make_state(id));
+                    mapped_reader in(path);           // Own cursor, shared page cache
+                    for (size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < idx.chunks(); ) {
+                        in.seek(idx.begin(c));
+                        in.loop([&](const record& r) { func(*states[id], r); }, idx.end(c));
+                        if constexpr (requires (State& s) { s.flush(); })
+                            states[id]->flush();
+                    }
+                }
+                catch (...) {
+                    errors[id] = std::current_exception();
+                }
+            });
+        }
+        for (auto& t : workers)
+            t.join();
+
+        std::vector<State> out;
+        for (unsigned id = 0; id < nthreads; ++id) {
+            if (errors[id])
+                std::rethrow_exception(errors[id]);
+            out.push_back(std::move(*states[id]));
+        }
+        return out;
+    }
+
+}
+
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef _REACTOR_HPP_
+#define _REACTOR_HPP_
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+#include "socket.hpp"
+
+namespace npl {
+
+// Single-threaded event loop built on epoll. Sockets are registered (by file
+// descriptor) together with a callback that receives the ready events mask.
+// Registered sockets are expected to be in non-blocking mode.
+
+class reactor {
+public:
+    typedef std::function<void(uint32_t)> handler;
+
+private:
+    int _epfd;
+    bool _running = false;
+    std::vector<epoll_event> _events;
+    std::vector<std::unique_ptr<handler>> _handlers;  // Indexed by fd
+    std::vector<std::unique_ptr<handler>> _retired;   // Removed while dispatching
+    std::vector<std::function<void()>> _deferred;     // Run at the end of the tick
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> _timers;
+
+public:
+    explicit reactor(int max_events = 256)
+    : _events(max_events)
+    {
+        if ( (_epfd = ::epoll_create1(EPOLL_CLOEXEC)) == -1 ) {
+            throw std::system_error(errno, std::system_category(), "epoll_create1");
+        }
+    }
+
+    reactor(const reactor&) = delete;
+    reactor& operator=(const reactor&) = delete;
+
+    ~reactor()
+    {
+        ::close(_epfd);
+    }
+
+    int fd() const
+    {
+        return _epfd;
+    }
+
+    void add(int fd, uint32_t events, handler h)
+    {
+        epoll_event ev = {};
+        ev.events  = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            throw std::system_error(errno, std::system_category(), "epoll_ctl add");
+        }
+        if (static_cast<size_t>(fd) >= _handlers.size()) {
+            _handlers.resize(fd + 1);
+        }
+        _handlers[fd] = std::make_unique<handler>(std::move(h));
+    }
+
+    template<int F, int type>
+    void add(const socket<F,type>& sock, uint32_t events, handler h)
+    {
+        this->add(sock.fd(), events, std::move(h));
+    }
+
+    void modify(int fd, uint32_t events)
+    {
+        epoll_event ev = {};
+        ev.events  = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+            throw std::system_error(errno, std::system_category(), "epoll_ctl mod");
+        }
+    }
+
+    template<int F, int type>
+    void modify(const socket<F,type>& sock, uint32_t events)
+    {
+        this->modify(sock.fd(), events);
+    }
+
+    // Must be called before the socket is closed. The handler may remove
+    // its own fd: it is kept alive until the current dispatch round ends.
+    void remove(int fd)
+    {
+        ::epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, nullptr);
+        if (static_cast<size_t>(fd) < _handlers.size() && _handlers[fd]) {
+            _retired.push_back(std::move(_handlers[fd]));
+        }
+    }
+
+    template<int F, int type>
+    void remove(const socket<F,type>& sock)
+    {
+        this->remove(sock.fd());
+    }
+
+    // Run f once, after the handlers of the current round (the end of the
+    // tick), e.g. to flush the output gathered by several handlers in one
+    // write. Deferred from a deferred call: runs at the end of the next tick,
+    // which then does not block waiting for events.
+    void defer(std::function<void()> f)
+    {
+        _deferred.push_back(std::move(f));
+    }
+
+    // Run f once, d from now (at the end of a tick, with the deferred calls)
+    void after(std::chrono::milliseconds d, std::function<void()> f)
+    {
+        _timers.emplace(std::chrono::steady_clock::now() + d, std::move(f));
+    }
+
+    // Wait for events and dispatch them. Returns the number of ready fds.
+    int poll(int timeout_ms = -1)
+    {
+        if (!_deferred.empty()) {
+            timeout_ms = 0;
+        } else if (!_timers.empty()) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(_timers.begin()->first - std::chrono::steady_clock::now()).count();
+            left = std::max<decltype(left)>(left, 0);
+            if (timeout_ms < 0 || left < timeout_ms)
+                timeout_ms = left;
+        }
+        int n = ::epoll_wait(_epfd, _events.data(), _events.size(), timeout_ms);
+        if (n == -1) {
+            if (errno == EINTR)
+                return 0;
+            throw std::system_error(errno, std::system_category(), "epoll_wait");
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = _events[i].data.fd;
+            // Skip fds removed earlier in this round
+            if (static_cast<size_t>(fd) < _handlers.size() && _handlers[fd]) {
+                (*_handlers[fd])(_events[i].events);
+            }
+        }
+        if (!_deferred.empty()) {
+            auto deferred = std::move(_deferred);
+            _deferred.clear();
+            for (auto& f : deferred)
+                f();
+        }
+        if (!_timers.empty()) {
+            // Take the due timers out first: they may add new ones
+            auto now = std::chrono::steady_clock::now();
+            std::vector<std::function<void()>> due;
+            for (auto it = _timers.begin(); it != _timers.end() && it->first <= now; it = _timers.erase(it))
+                due.push_back(std::move(it->second));
+            for (auto& f : due)
+                f();
+        }
+        _retired.clear();
+        return n;
+    }
+
+    void run()
+    {
+        _running = true;
+        while (_running) {
+            this->poll();
+        }
+    }
+
+    void stop()
+    {
+        _running = false;
+    }
+};
+
+}
+
+
+#endif
@@ -13,6 +13,7 @@
 #include <system_error>
 #include <utility>
 #include <sstream>
+#include "format.hpp"
 
 #ifdef __linux__
     #include <linux/if_packet.h>
@@ -191,13 +192,8 @@ public:
     std::string
     host() const
     {
-        char pres[INET_ADDRSTRLEN];
-
-        if ( ( inet_ntop(AF_INET, reinterpret_cast<const void*>(&_addr.sin_addr), pres, sizeof(pres)) ) == nullptr ) 
-        {
-            throw std::system_error(errno, std::generic_category(), "inet_ntop");
-        }
-        return pres;
+        char pres[IPV4_STRLEN];
+        return std::string(pres, format_ipv4(_addr.sin_addr, pres));
     }
 
     std::pair<std::string,std::string>
@@ -256,7 +252,149 @@ public:
 
 template<>
 class sockaddress<AF_INET6> {
+private:
+    socklen_t    _len;
+    sockaddr_in6 _addr;
+
+public:
+    explicit sockaddress(in_port_t port = 0)  // Empty socket address (in6addr_any)
+    : _len(sizeof(sockaddr_in6))
+    {
+        memset(&_addr,0,sizeof(sockaddr_in6));
+        _addr.sin6_family = AF_INET6;
+        _addr.sin6_port   = htons(port);
+        _addr.sin6_addr   = in6addr_any;
+    }
+
+    sockaddress(const sockaddr_in6& addr)
+    : _len(sizeof(sockaddr_in6))
+    {
+        memset(&_addr,0,sizeof(sockaddr_in6));
+        _addr = addr;
+    }
+
+    sockaddress(const in6_addr& ip, const in_port_t port = 0, uint32_t scope_id = 0)
+    : _len(sizeof(sockaddr_in6))
+    {
+        memset(&_addr,0,sizeof(sockaddr_in6));
+        _addr.sin6_family   = AF_INET6;
+        _addr.sin6_port     = htons(port);
+        _addr.sin6_addr     = ip;
+        _addr.sin6_scope_id = scope_id;
+    }
+
+    sockaddress(const std::string& host, const in_port_t& port)
+    : sockaddress(host, std::to_string(port))
+    {}
+
+    sockaddress(const std::string& host, const std::string& service)
+    : _len(sizeof(sockaddr_in6))
+    {
+        struct addrinfo *result;
+        struct addrinfo hints{};
+        hints.ai_family = AF_INET6;
+
+        int errcode;
+        if ( (errcode = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &result )) != 0 )
+        {
+            throw std::system_error(errcode, std::generic_category(), "getaddrinfo");
+        }
+
+        _addr = *(reinterpret_cast<struct sockaddr_in6*>(result->ai_addr));
+        freeaddrinfo(result);
+    }
+
+    sockaddress(const sockaddress&)            = default;
+    sockaddress& operator=(const sockaddress&) = default;
+    sockaddress(sockaddress&&)                 = default;
+    sockaddress& operator=(sockaddress&&)      = default;
+    ~sockaddress()                             = default;
+
+
+    in_port_t
+    port() const
+    {
+        return ntohs(_addr.sin6_port);
+    }
+
+    std::string
+    host() const
+    {
+        char pres[INET6_ADDRSTRLEN];
+
+        if ( ( inet_ntop(AF_INET6, reinterpret_cast<const void*>(&_addr.sin6_addr), pres, sizeof(pres)) ) == nullptr )
+        {
+            throw std::system_error(errno, std::generic_category(), "inet_ntop");
+        }
+        return pres;
+    }
+
+    const in6_addr&
+    addr() const
+    {
+        return _addr.sin6_addr;
+    }
 
+    uint32_t
+    scope_id() const
+    {
+        return _addr.sin6_scope_id;
+    }
+
+    uint32_t
+    flowinfo() const
+    {
+        return ntohl(_addr.sin6_flowinfo);
+    }
+
+    // True for ::ffff:a.b.c.d, i.e. an IPv4 peer seen through a dual-stack socket
+    bool
+    v4_mapped() const
+    {
+        return IN6_IS_ADDR_V4MAPPED(&_addr.sin6_addr);
+    }
+
+    unsigned short
+    family() const
+    {
+        return _addr.sin6_family;
+    }
+
+    socklen_t
+    len() const
+    {
+        return _len;
+    }
+
+    socklen_t&
+    len()
+    {
+        return _len;
+    }
+
+    const sockaddr&
+    c_addr() const
+    {
+        return reinterpret_cast<const sockaddr&>(_addr);
+    }
+
+    sockaddr&
+    c_addr()
+    {
+        return reinterpret_cast<struct sockaddr&>(_addr);
+    }
+
+    std::pair<std::string, std::string>
+    nameinfo(int flags = 0) const
+    {
+        int errcode;
+        char hostname[NI_MAXHOST], service[NI_MAXSERV];
+        if ( (errcode = ::getnameinfo(&this->c_addr(), this->_len, hostname, sizeof(hostname), service, sizeof(service), flags)) != 0 )
+        {
+            throw std::system_error(errcode, std::generic_category(), "getnameinfo");
+        }
+        return std::make_pair(hostname, service);
+    }
 };
 
 #ifdef __linux__
@@ -326,13 +464,8 @@ class sockaddress<AF_INET6> {
 
         std::string
         hw_addr() const{
-            std::stringstream ss;
-            for (auto i = 0 ; i <= 4; ++i)
-            {
-               ss << std::hex << static_cast<u_short>(_addr.sll_addr[i]) << ":";
-            }
-            ss << static_cast<u_short>(_addr.sll_addr[5]);
-            return ss.str();
+            char mac[MAC_STRLEN];
+            return std::string(mac, format_mac(_addr.sll_addr, mac));
         }
 
         unsigned short
@@ -397,9 +530,17 @@ template <>
 std::string
 inline ntop<AF_INET, uint32_t>(const uint32_t& addr)
 {
-    char pres[INET_ADDRSTRLEN];
+    char pres[IPV4_STRLEN];
+    return std::string(pres, format_ipv4(addr, pres));
+}
+
+template <>
+std::string
+inline ntop<AF_INET6, in6_addr>(const in6_addr& addr)
+{
+    char pres[INET6_ADDRSTRLEN];
 
-    if ( ( inet_ntop(AF_INET, reinterpret_cast<const void*>(&addr), pres, sizeof(pres)) ) == nullptr ) 
+    if ( ( inet_ntop(AF_INET6, reinterpret_cast<const void*>(&addr), pres, sizeof(pres)) ) == nullptr ) 
     {
         throw std::system_error(errno, std::generic_category(), "inet_ntop");
     }
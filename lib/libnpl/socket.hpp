@@ -1,28 +1,350 @@
 #ifndef _SOCKET_HPP_
 #define _SOCKET_HPP_
+#include <algorithm>
+#include <climits>
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
+#include <span>
 #include <system_error>
 #include <unistd.h>
 #include <utility>
 #include <vector>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
 #include "sockaddress.hpp"
 
 namespace npl {
 
 typedef std::vector<uint8_t> buffer;
 
+// Preallocated datagram slots (payload buffer + peer address) for
+// socket::recv_batch / socket::send_batch (recvmmsg/sendmmsg).
+// payload(i) is the received datagram after recv_batch, and what gets
+// sent by send_batch: received slots can be echoed in place.
+
+template<int F>
+class dgram_batch {
+private:
+    size_t _slot_size;
+    socklen_t _name_len;
+    std::vector<std::byte> _data;
+    std::vector<sockaddress<F>> _addrs;
+    std::vector<iovec> _iovs;
+    std::vector<mmsghdr> _msgs;
+
+public:
+    dgram_batch(size_t slots, size_t slot_size)
+    : _slot_size(slot_size)
+    , _name_len(sockaddress<F>().len())
+    , _data(slots * slot_size)
+    , _addrs(slots)
+    , _iovs(slots)
+    , _msgs(slots)
+    {
+        for (size_t i = 0; i < slots; ++i) {
+            _iovs[i].iov_base = &_data[i * slot_size];
+            _iovs[i].iov_len  = slot_size;
+            memset(&_msgs[i], 0, sizeof(mmsghdr));
+            _msgs[i].msg_hdr.msg_iov    = &_iovs[i];
+            _msgs[i].msg_hdr.msg_iovlen = 1;
+            _msgs[i].msg_hdr.msg_name   = &_addrs[i].c_addr();
+        }
+    }
+
+    // Slots point into the batch itself
+    dgram_batch(const dgram_batch&) = delete;
+    dgram_batch& operator=(const dgram_batch&) = delete;
+
+    size_t capacity() const
+    {
+        return _msgs.size();
+    }
+
+    size_t slot_size() const
+    {
+        return _slot_size;
+    }
+
+    std::span<std::byte> payload(size_t i)
+    {
+        return std::span<std::byte>(static_cast<std::byte*>(_iovs[i].iov_base), _iovs[i].iov_len);
+    }
+
+    // Length of the datagram to send from slot i
+    void set_len(size_t i, size_t len)
+    {
+        _iovs[i].iov_len = std::min(len, _slot_size);
+    }
+
+    sockaddress<F>& addr(size_t i)
+    {
+        return _addrs[i];
+    }
+
+    const sockaddress<F>& addr(size_t i) const
+    {
+        return _addrs[i];
+    }
+
+    mmsghdr* prepare_recv()
+    {
+        for (size_t i = 0; i < _msgs.size(); ++i) {
+            _iovs[i].iov_len = _slot_size;
+            _msgs[i].msg_hdr.msg_namelen = _name_len;
+        }
+        return _msgs.data();
+    }
+
+    void complete_recv(int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            _iovs[i].iov_len = _msgs[i].msg_len;
+            _addrs[i].len()  = _msgs[i].msg_hdr.msg_namelen;
+        }
+    }
+
+    mmsghdr* prepare_send(size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            _msgs[i].msg_hdr.msg_namelen = _addrs[i].len();
+        }
+        return _msgs.data();
+    }
+};
+
+// Splits a UDP GRO super-buffer back into its datagrams: every datagram is
+// segment_size bytes long except possibly the last one.
+
+class segment_view {
+private:
+    std::span<std::byte> _buf;
+    size_t _seg;
+
+public:
+    class iterator {
+    private:
+        std::span<std::byte> _rest;
+        size_t _seg;
+
+    public:
+        iterator(std::span<std::byte> rest, size_t seg)
+        : _rest(rest), _seg(seg)
+        {}
+
+        std::span<std::byte> operator*() const
+        {
+            return _rest.first(std::min(_seg, _rest.size()));
+        }
+
+        iterator& operator++()
+        {
+            _rest = _rest.subspan(std::min(_seg, _rest.size()));
+            return *this;
+        }
+
+        bool operator==(const iterator& rhs) const
+        {
+            return _rest.size() == rhs._rest.size();
+        }
+    };
+
+    segment_view(std::span<std::byte> buf, size_t segment_size)
+    : _buf(buf), _seg(segment_size == 0 ? buf.size() : segment_size)
+    {}
+
+    iterator begin() const
+    {
+        return iterator(_buf, _seg);
+    }
+
+    iterator end() const
+    {
+        return iterator(_buf.subspan(_buf.size()), _seg);
+    }
+
+    size_t size() const
+    {
+        return _seg == 0 ? 0 : (_buf.size() + _seg - 1) / _seg;
+    }
+};
+
+// Views for the vectored calls (writev, readv, sendmsg, recvmsg): an iovec
+// over caller memory, e.g. {as_iovec(header), as_iovec(payload)}.
+
+inline iovec as_iovec(std::span<const std::byte> buf)
+{
+    return iovec{ const_cast<std::byte*>(buf.data()), buf.size() };
+}
+
+inline iovec as_iovec(const buffer& buf)
+{
+    return iovec{ const_cast<uint8_t*>(buf.data()), buf.size() };
+}
+
+// Ancillary (control) data for sendmsg/recvmsg, in an aligned buffer of N
+// bytes: add() messages before sending (e.g. SCM_RIGHTS, UDP_SEGMENT),
+// find() or for_each() them after receiving.
+
+template<size_t N>
+class ancillary {
+private:
+    alignas(cmsghdr) std::byte _buf[N];
+    size_t _len = 0;
+    bool _truncated = false;
+
+    template<int F, int type> friend class socket;
+
+public:
+    template<typename T>
+    bool add(int level, int type, const T& value)
+    {
+        if (_len + CMSG_SPACE(sizeof(T)) > N)
+            return false;
+        auto cm = reinterpret_cast<cmsghdr*>(_buf + _len);
+        memset(cm, 0, CMSG_SPACE(sizeof(T)));
+        cm->cmsg_level = level;
+        cm->cmsg_type  = type;
+        cm->cmsg_len   = CMSG_LEN(sizeof(T));
+        memcpy(CMSG_DATA(cm), &value, sizeof(T));
+        _len += CMSG_SPACE(sizeof(T));
+        return true;
+    }
+
+    // func(level, type, std::span<const std::byte> data) for each message
+    template<typename Func>
+    void for_each(Func&& func) const
+    {
+        msghdr msg = {};
+        msg.msg_control = const_cast<std::byte*>(_buf);
+        msg.msg_controllen = _len;
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            auto data = reinterpret_cast<const std::byte*>(CMSG_DATA(cm));
+            func(cm->cmsg_level, cm->cmsg_type,
+                 std::span<const std::byte>(data, cm->cmsg_len - (data - reinterpret_cast<const std::byte*>(cm))));
+        }
+    }
+
+    template<typename T>
+    std::optional<T> find(int level, int type) const
+    {
+        std::optional<T> out;
+        for_each([&](int l, int t, std::span<const std::byte> data) {
+            if (l == level && t == type && data.size() >= sizeof(T) && !out) {
+                T v;
+                memcpy(&v, data.data(), sizeof(T));
+                out = v;
+            }
+        });
+        return out;
+    }
+
+    void clear()
+    {
+        _len = 0;
+        _truncated = false;
+    }
+
+    size_t size() const
+    {
+        return _len;
+    }
+
+    // The last recvmsg had more control data than fits (MSG_CTRUNC)
+    bool truncated() const
+    {
+        return _truncated;
+    }
+};
+
+// Result of a try_* call on a (non-blocking) socket: the byte count, or the
+// errno of the failure, captured right after the call. A read of 0 bytes
+// that is ok() is end of stream; would_block() means retry when ready.
+
+struct io_result {
+    std::ptrdiff_t bytes = 0;
+    int error = 0;
+
+    static io_result from(std::ptrdiff_t n)
+    {
+        return (n == -1) ? io_result{0, errno} : io_result{n, 0};
+    }
+
+    bool ok() const
+    {
+        return error == 0;
+    }
+
+    bool would_block() const
+    {
+        return error == EAGAIN || error == EWOULDBLOCK;
+    }
+
+    // Neither data nor would-block: the connection is done (EOF or error)
+    bool closed() const
+    {
+        return ok() ? bytes == 0 : !would_block() && error != EINTR;
+    }
+
+    explicit operator bool() const
+    {
+        return ok();
+    }
+};
+
 template<int F, int type>
 class socket {
 private:
     int _sockfd;
 
+    // Takes ownership of an already open descriptor
+    struct adopt {};
+    socket(adopt, int fd)
+    : _sockfd(fd)
+    {}
+
+    static msghdr make_msghdr(std::span<const iovec> iov, const sockaddr* name, socklen_t namelen,
+                              const std::byte* control, size_t controllen)
+    {
+        msghdr msg = {};
+        msg.msg_name = const_cast<sockaddr*>(name);
+        msg.msg_namelen = namelen;
+        msg.msg_iov = const_cast<iovec*>(iov.data());
+        msg.msg_iovlen = iov.size();
+        msg.msg_control = const_cast<std::byte*>(control);
+        msg.msg_controllen = controllen;
+        return msg;
+    }
+
+    std::ptrdiff_t sendmsg_raw(std::span<const iovec> iov, const sockaddr* name, socklen_t namelen,
+                               const std::byte* control, size_t controllen, int flags) const
+    {
+        msghdr msg = make_msghdr(iov, name, namelen, control, controllen);
+        return ::sendmsg(_sockfd, &msg, flags);
+    }
+
+    // Would-block as nullopt, for the async_* awaitables
+    static std::optional<std::ptrdiff_t> unless_blocked(std::ptrdiff_t n)
+    {
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return std::nullopt;
+        return n;
+    }
+
 public:
-    explicit socket(int protocol = 0)
+    // flags: SOCK_NONBLOCK and/or SOCK_CLOEXEC, set atomically at creation
+    explicit socket(int protocol = 0, int flags = 0)
     {
-        if ( ( _sockfd = ::socket(F,type,protocol)) == -1) {
+        if ( ( _sockfd = ::socket(F,type | flags,protocol)) == -1) {
             throw std::system_error(errno, std::generic_category(), "socket");
         }
     }
@@ -38,7 +360,7 @@ public:
 
     socket& operator=(socket&& rhs)
     {
-        if (*this != rhs)
+        if (this != &rhs)
         {
             this->close();
             _sockfd = rhs._sockfd;
@@ -64,6 +386,11 @@ public:
         }
     }
 
+    int fd() const
+    {
+        return _sockfd;
+    }
+
 
     void bind(const sockaddress<F>& addr)
     {
@@ -83,14 +410,39 @@ public:
         }
     }
         
-    std::pair< socket, sockaddress<F> > accept()
+    // flags (SOCK_NONBLOCK, SOCK_CLOEXEC) apply to the new socket: accept4
+    std::pair< socket, sockaddress<F> > accept(int flags = 0)
     {
         sockaddress<F> peer;
-        socket accepted;
-        if ( (accepted._sockfd = ::accept(_sockfd, &peer.c_addr(), &peer.len())) == -1 ) {
+        int fd = ::accept4(_sockfd, &peer.c_addr(), &peer.len(), flags);
+        if (fd == -1) {
             throw std::system_error(errno,std::system_category(),"accept");
         }
-        return std::make_pair(std::move(accepted), peer);
+        return std::make_pair(socket(adopt{}, fd), peer);
+    }
+
+    // Outcome of try_accept: sock is set when status.ok()
+    struct accept_result {
+        io_result status;
+        std::optional<socket> sock;
+        sockaddress<F> peer;
+
+        explicit operator bool() const
+        {
+            return status.ok();
+        }
+    };
+
+    // Non-throwing accept for readiness loops: call until would_block()
+    accept_result try_accept(int flags = SOCK_NONBLOCK | SOCK_CLOEXEC)
+    {
+        accept_result r;
+        int fd = ::accept4(_sockfd, &r.peer.c_addr(), &r.peer.len(), flags);
+        r.status = io_result::from(fd == -1 ? -1 : 0);
+        if (fd != -1) {
+            r.sock.emplace(socket(adopt{}, fd));
+        }
+        return r;
     }
         
     void connect(const sockaddress<F>& remote)
@@ -101,19 +453,165 @@ public:
     }
 
     // I/O methods
+    //
+    // Overloads taking a std::span<std::byte> work on caller-owned memory and
+    // return the byte count (-1 with errno on error): no allocation on the
+    // data path. The overloads returning a fresh buffer are kept for
+    // convenience and throw std::system_error on error. For non-blocking
+    // sockets, the try_* variants below return an io_result instead.
+
+    // Vectored I/O: one system call for several buffers, e.g. a header and
+    // a payload without concatenating them. writevn continues after short
+    // writes (like writen); iov itself is left untouched.
+
+    std::ptrdiff_t writev(std::span<const iovec> iov) const
+    {
+        return ::writev(_sockfd, iov.data(), iov.size());
+    }
+
+    std::ptrdiff_t readv(std::span<const iovec> iov) const
+    {
+        return ::readv(_sockfd, iov.data(), iov.size());
+    }
+
+    std::ptrdiff_t writevn(std::span<const iovec> iov) const
+    {
+        if (iov.size() > IOV_MAX) {
+            errno = EINVAL;
+            return -1;
+        }
+        iovec left[IOV_MAX];
+        std::copy(iov.begin(), iov.end(), left);
+        iovec* first = left;
+        size_t count = iov.size();
+        std::ptrdiff_t tot_written = 0;
+
+        while (count > 0) {
+            auto n = ::writev(_sockfd, first, count);
+            if (n == -1) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            tot_written += n;
+            // Skip what went out: whole buffers, then part of the next
+            for (; count > 0 && static_cast<size_t>(n) >= first->iov_len; ++first, --count)
+                n -= first->iov_len;
+            if (count > 0) {
+                first->iov_base = static_cast<std::byte*>(first->iov_base) + n;
+                first->iov_len -= n;
+            }
+        }
+        return tot_written;
+    }
+
+    // Send len bytes of the file in_fd from offset, straight from the page
+    // cache: the payload never enters user space. May send less than len
+    // (e.g. on a non-blocking socket); sendfilen continues until len or EOF.
+
+    std::ptrdiff_t sendfile(int in_fd, off_t offset, size_t len) const
+    {
+        return ::sendfile(_sockfd, in_fd, &offset, len);
+    }
+
+    std::ptrdiff_t sendfilen(int in_fd, off_t offset, size_t len) const
+    {
+        std::ptrdiff_t tot_sent = 0;
+        while (static_cast<size_t>(tot_sent) < len) {
+            auto n = ::sendfile(_sockfd, in_fd, &offset, len - tot_sent);
+            if (n == 0)
+                break;          // EOF: the file is shorter than len
+            if (n == -1) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            tot_sent += n;
+        }
+        return tot_sent;
+    }
+
+    // sendmsg/recvmsg with optional peer address (datagrams) and ancillary data
+
+    std::ptrdiff_t sendmsg(std::span<const iovec> iov, int flags = 0) const
+    {
+        return this->sendmsg_raw(iov, nullptr, 0, nullptr, 0, flags);
+    }
+
+    template<size_t N>
+    std::ptrdiff_t sendmsg(std::span<const iovec> iov, const ancillary<N>& ctl, int flags = 0) const
+    {
+        return this->sendmsg_raw(iov, nullptr, 0, ctl._buf, ctl._len, flags);
+    }
+
+    std::ptrdiff_t sendmsg(std::span<const iovec> iov, const sockaddress<F>& remote, int flags = 0) const
+    {
+        return this->sendmsg_raw(iov, &remote.c_addr(), remote.len(), nullptr, 0, flags);
+    }
+
+    template<size_t N>
+    std::ptrdiff_t sendmsg(std::span<const iovec> iov, const sockaddress<F>& remote, const ancillary<N>& ctl, int flags = 0) const
+    {
+        return this->sendmsg_raw(iov, &remote.c_addr(), remote.len(), ctl._buf, ctl._len, flags);
+    }
+
+    std::ptrdiff_t recvmsg(std::span<const iovec> iov, int flags = 0) const
+    {
+        msghdr msg = this->make_msghdr(iov, nullptr, 0, nullptr, 0);
+        return ::recvmsg(_sockfd, &msg, flags);
+    }
+
+    template<size_t N>
+    std::ptrdiff_t recvmsg(std::span<const iovec> iov, ancillary<N>& ctl, int flags = 0) const
+    {
+        msghdr msg = this->make_msghdr(iov, nullptr, 0, ctl._buf, N);
+        auto n = ::recvmsg(_sockfd, &msg, flags);
+        ctl._len = (n == -1) ? 0 : msg.msg_controllen;
+        ctl._truncated = (n != -1) && (msg.msg_flags & MSG_CTRUNC);
+        return n;
+    }
+
+    std::ptrdiff_t recvmsg(std::span<const iovec> iov, sockaddress<F>& remote, int flags = 0) const
+    {
+        msghdr msg = this->make_msghdr(iov, &remote.c_addr(), remote.len(), nullptr, 0);
+        auto n = ::recvmsg(_sockfd, &msg, flags);
+        if (n != -1) {
+            remote.len() = msg.msg_namelen;
+        }
+        return n;
+    }
+
+    template<size_t N>
+    std::ptrdiff_t recvmsg(std::span<const iovec> iov, sockaddress<F>& remote, ancillary<N>& ctl, int flags = 0) const
+    {
+        msghdr msg = this->make_msghdr(iov, &remote.c_addr(), remote.len(), ctl._buf, N);
+        auto n = ::recvmsg(_sockfd, &msg, flags);
+        if (n != -1) {
+            remote.len() = msg.msg_namelen;
+        }
+        ctl._len = (n == -1) ? 0 : msg.msg_controllen;
+        ctl._truncated = (n != -1) && (msg.msg_flags & MSG_CTRUNC);
+        return n;
+    }
 
     std::ptrdiff_t write(const buffer& buf) const
     {
         return ::write(_sockfd, &buf[0], buf.size());
     }
 
-    std::ptrdiff_t writen(const buffer& buf, ssize_t n)
+    std::ptrdiff_t write(std::span<const std::byte> buf) const
+    {
+        return ::write(_sockfd, buf.data(), buf.size());
+    }
+
+    std::ptrdiff_t writen(std::span<const std::byte> buf) const
     {
         std::ptrdiff_t num_written;
         std::ptrdiff_t tot_written = 0;
+        std::ptrdiff_t n = buf.size();
 
         while (tot_written < n ) {
-            num_written = ::write(_sockfd, &buf[tot_written], n-tot_written); 
+            num_written = ::write(_sockfd, buf.data() + tot_written, n-tot_written); 
 
             if (num_written <= 0)  // An error has happened
             {
@@ -127,36 +625,64 @@ public:
         return tot_written;
     }
 
+    std::ptrdiff_t writen(const buffer& buf, ssize_t n)
+    {
+        return this->writen(std::as_bytes(std::span(buf)).first(n));
+    }
+
     std::ptrdiff_t      send(const buffer& buf, int flags = 0) const
     {
        return ::send(_sockfd, &buf[0], buf.size(), flags);
     }
 
+    std::ptrdiff_t      send(std::span<const std::byte> buf, int flags = 0) const
+    {
+       return ::send(_sockfd, buf.data(), buf.size(), flags);
+    }
+
     std::ptrdiff_t 
     sendto(const buffer& buf, const sockaddress<F>& remote, int flags = 0) const 
     {
         return ::sendto(_sockfd, &buf[0], buf.size(), flags, &remote.c_addr(), remote.len());
     }
 
+    std::ptrdiff_t 
+    sendto(std::span<const std::byte> buf, const sockaddress<F>& remote, int flags = 0) const 
+    {
+        return ::sendto(_sockfd, buf.data(), buf.size(), flags, &remote.c_addr(), remote.len());
+    }
+
     std::ptrdiff_t read(buffer& buf) const
     {
         return ::read(_sockfd, &buf[0], buf.size());
     }
+
+    std::ptrdiff_t read(std::span<std::byte> buf) const
+    {
+        return ::read(_sockfd, buf.data(), buf.size());
+    }
+
     buffer read(size_t n) const 
     {
         buffer buf(n);
-        int nbytes = ::read(_sockfd, &buf[0], buf.size());
-        return buffer(buf.begin(),buf.begin()+nbytes);
+        auto nbytes = this->read(std::as_writable_bytes(std::span(buf)));
+        if (nbytes == -1) {
+            throw std::system_error(errno,std::system_category(),"read");
+        }
+        buf.resize(nbytes);
+        return buf;
     }
 
-    std::ptrdiff_t readn(buffer& buf, ssize_t n ) const
+    // Reads until buf is full or EOF
+    std::ptrdiff_t readn(std::span<std::byte> buf) const
     {
         std::ptrdiff_t num_read;
         std::ptrdiff_t tot_read = 0;
+        std::ptrdiff_t n = buf.size();
 
         while(tot_read < n)
         {
-            num_read = ::read(_sockfd, &buf[tot_read], n - tot_read);
+            num_read = ::read(_sockfd, buf.data() + tot_read, n - tot_read);
 
             if (num_read == 0)
                 return tot_read;  // EOF reached;
@@ -174,11 +700,20 @@ public:
         return tot_read;
     }
 
+    std::ptrdiff_t readn(buffer& buf, ssize_t n ) const
+    {
+        return this->readn(std::as_writable_bytes(std::span(buf)).first(n));
+    }
+
     buffer     readn(ssize_t len ) const
     {
         buffer buf(len);
         auto tot_read = this->readn(buf,len);
-        return buffer(buf.begin(),buf.begin()+tot_read);
+        if (tot_read == -1) {
+            throw std::system_error(errno,std::system_category(),"readn");
+        }
+        buf.resize(tot_read);
+        return buf;
     }
 
 
@@ -187,11 +722,20 @@ public:
         return ::recv(_sockfd, &buf[0], buf.size(), flags);
     }
 
+    std::ptrdiff_t      recv(std::span<std::byte> buf, int flags = 0) const
+    {
+        return ::recv(_sockfd, buf.data(), buf.size(), flags);
+    }
+
     buffer              recv(int len, int flags = 0) const
     {
         buffer buf(len);
-        std::ptrdiff_t n = ::recv(_sockfd, &buf[0], buf.size(), flags);
-        return buffer(buf.begin(),buf.begin()+n);
+        auto n = this->recv(std::as_writable_bytes(std::span(buf)), flags);
+        if (n == -1) {
+            throw std::system_error(errno,std::system_category(),"recv");
+        }
+        buf.resize(n);
+        return buf;
     }
 
     std::ptrdiff_t      recvn(buffer& buf, int flags = 0) const
@@ -199,31 +743,149 @@ public:
         return ::recv(_sockfd, &buf[0], buf.size(), flags | MSG_WAITALL);
     }
 
+    std::ptrdiff_t      recvn(std::span<std::byte> buf, int flags = 0) const
+    {
+        return ::recv(_sockfd, buf.data(), buf.size(), flags | MSG_WAITALL);
+    }
     
     buffer              recvn(int len, int flags = 0) const
     {
         buffer buf(len);
-        std::ptrdiff_t n = ::recv(_sockfd, &buf[0], buf.size(), flags | MSG_WAITALL);
-        return buffer(buf.begin(),buf.begin()+n);
+        auto n = this->recvn(std::as_writable_bytes(std::span(buf)), flags);
+        if (n == -1) {
+            throw std::system_error(errno,std::system_category(),"recvn");
+        }
+        buf.resize(n);
+        return buf;
     }
 
 
-
-
-
     std::ptrdiff_t
     recvfrom(buffer& buf, sockaddress<F>& remote, int flags = 0) const
     {
         return ::recvfrom(_sockfd, &buf[0], buf.size(), flags, &remote.c_addr(), &remote.len());
     }
 
+    std::ptrdiff_t
+    recvfrom(std::span<std::byte> buf, sockaddress<F>& remote, int flags = 0) const
+    {
+        return ::recvfrom(_sockfd, buf.data(), buf.size(), flags, &remote.c_addr(), &remote.len());
+    }
+
     std::pair<buffer, sockaddress<F>>
     recvfrom(size_t n, int flags = 0) const
     {
         buffer buf(n);
         sockaddress<F> remote;
-        int nbytes = ::recvfrom(_sockfd, &buf[0], buf.size(), flags, &remote.c_addr(), &remote.len());
-        return std::make_pair(buffer(buf.begin(),buf.begin()+nbytes),remote);
+        auto nbytes = this->recvfrom(std::as_writable_bytes(std::span(buf)), remote, flags);
+        if (nbytes == -1) {
+            throw std::system_error(errno,std::system_category(),"recvfrom");
+        }
+        buf.resize(nbytes);
+        return std::make_pair(std::move(buf),remote);
+    }
+
+    // Non-blocking I/O: the errno is kept in the result, no exceptions
+
+    io_result try_read(std::span<std::byte> buf) const
+    {
+        return io_result::from(::read(_sockfd, buf.data(), buf.size()));
+    }
+
+    io_result try_write(std::span<const std::byte> buf) const
+    {
+        return io_result::from(::write(_sockfd, buf.data(), buf.size()));
+    }
+
+    io_result try_recv(std::span<std::byte> buf, int flags = 0) const
+    {
+        return io_result::from(::recv(_sockfd, buf.data(), buf.size(), flags | MSG_DONTWAIT));
+    }
+
+    io_result try_send(std::span<const std::byte> buf, int flags = 0) const
+    {
+        return io_result::from(::send(_sockfd, buf.data(), buf.size(), flags | MSG_DONTWAIT));
+    }
+
+    io_result try_recvfrom(std::span<std::byte> buf, sockaddress<F>& remote, int flags = 0) const
+    {
+        return io_result::from(::recvfrom(_sockfd, buf.data(), buf.size(), flags | MSG_DONTWAIT, &remote.c_addr(), &remote.len()));
+    }
+
+    io_result try_sendto(std::span<const std::byte> buf, const sockaddress<F>& remote, int flags = 0) const
+    {
+        return io_result::from(::sendto(_sockfd, buf.data(), buf.size(), flags | MSG_DONTWAIT, &remote.c_addr(), remote.len()));
+    }
+
+    // Coroutine I/O (see coro.hpp): co_await sock.async_read(loop, buf) etc.
+    // Same results as the blocking calls (-1 with errno on error), but the
+    // coroutine is parked on loop instead of blocking the thread. The socket
+    // must be non-blocking; async_accept returns non-blocking sockets.
+
+    template<typename Loop>
+    auto async_accept(Loop& loop)
+    {
+        return loop.io(_sockfd, EPOLLIN, [this]() -> std::optional<std::pair<socket, sockaddress<F>>> {
+            sockaddress<F> peer;
+            int fd = ::accept4(_sockfd, &peer.c_addr(), &peer.len(), SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return std::nullopt;
+                throw std::system_error(errno,std::system_category(),"accept4");
+            }
+            return std::make_pair(socket(adopt{}, fd), peer);
+        });
+    }
+
+    template<typename Loop>
+    auto async_read(Loop& loop, std::span<std::byte> buf) const
+    {
+        return loop.io(_sockfd, EPOLLIN, [this, buf]() {
+            return unless_blocked(::read(_sockfd, buf.data(), buf.size()));
+        });
+    }
+
+    template<typename Loop>
+    auto async_write(Loop& loop, std::span<const std::byte> buf) const
+    {
+        return loop.io(_sockfd, EPOLLOUT, [this, buf]() {
+            return unless_blocked(::write(_sockfd, buf.data(), buf.size()));
+        });
+    }
+
+    template<typename Loop>
+    auto async_recvfrom(Loop& loop, std::span<std::byte> buf, sockaddress<F>& remote, int flags = 0) const
+    {
+        return loop.io(_sockfd, EPOLLIN, [this, buf, &remote, flags]() {
+            return unless_blocked(::recvfrom(_sockfd, buf.data(), buf.size(), flags, &remote.c_addr(), &remote.len()));
+        });
+    }
+
+    template<typename Loop>
+    auto async_sendto(Loop& loop, std::span<const std::byte> buf, const sockaddress<F>& remote, int flags = 0) const
+    {
+        return loop.io(_sockfd, EPOLLOUT, [this, buf, &remote, flags]() {
+            return unless_blocked(::sendto(_sockfd, buf.data(), buf.size(), flags, &remote.c_addr(), remote.len()));
+        });
+    }
+
+    // Batched datagram I/O: one system call for up to batch.capacity() datagrams.
+    // Return the number of datagrams received/sent, or -1 on error.
+    // By default recv_batch blocks for the first datagram only (MSG_WAITFORONE).
+
+    int recv_batch(dgram_batch<F>& batch, int flags = MSG_WAITFORONE) const requires (type == SOCK_DGRAM)
+    {
+        int n = ::recvmmsg(_sockfd, batch.prepare_recv(), batch.capacity(), flags, nullptr);
+        if (n > 0) {
+            batch.complete_recv(n);
+        }
+        return n;
+    }
+
+    int send_batch(dgram_batch<F>& batch, size_t count, int flags = 0) const requires (type == SOCK_DGRAM)
+    {
+        count = std::min(count, batch.capacity());
+        return ::sendmmsg(_sockfd, batch.prepare_send(count), count, flags);
     }
 
     // Socket Options
@@ -258,6 +920,105 @@ public:
        return out;
     }
 
+    // Several sockets bound to the same address/port: the kernel load balances
+    // incoming connections (or datagrams) among them
+    int set_reuseport() 
+    {
+       int optval = 1;
+       int out = ::setsockopt(_sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
+       if (out == -1) {
+          throw std::system_error(errno,std::generic_category(),"set_reuseport");
+       }
+       return out;
+    }
+
+    // TCP_NODELAY sends each write at once instead of holding small segments
+    // while earlier data is unacknowledged (Nagle): for senders that coalesce
+    // their own output, e.g. npl::buffered_writer. TCP_CORK instead holds
+    // partial segments until uncorked (or 200 ms), to send a header and the
+    // payload that follows (write + sendfile) as full segments.
+
+    int set_nodelay(bool on = true)
+    {
+       int optval = on;
+       int out = ::setsockopt(_sockfd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+       if (out == -1) {
+          throw std::system_error(errno,std::generic_category(),"set_nodelay");
+       }
+       return out;
+    }
+
+    // Uncorking sends whatever is held right away
+    int set_cork(bool on = true)
+    {
+       int optval = on;
+       int out = ::setsockopt(_sockfd, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval));
+       if (out == -1) {
+          throw std::system_error(errno,std::generic_category(),"set_cork");
+       }
+       return out;
+    }
+
+    int set_nonblocking(bool on = true)
+    {
+        int flags = ::fcntl(_sockfd, F_GETFL);
+        if (flags == -1) {
+            throw std::system_error(errno,std::generic_category(),"set_nonblocking");
+        }
+        flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        int out = ::fcntl(_sockfd, F_SETFL, flags);
+        if (out == -1) {
+            throw std::system_error(errno,std::generic_category(),"set_nonblocking");
+        }
+        return out;
+    }
+
+    // Zero-copy transmit (MSG_ZEROCOPY): the kernel pins the user pages
+    // instead of copying them, and reports on the error queue when each send
+    // no longer uses them. Buffers must stay untouched until then; see
+    // npl::zerocopy_pool. Sends are numbered from 0 per socket, one number
+    // per successful send call with MSG_ZEROCOPY.
+
+    int set_zerocopy(bool on = true)
+    {
+       int optval = on;
+       int out = ::setsockopt(_sockfd, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval));
+       if (out == -1) {
+          throw std::system_error(errno,std::generic_category(),"set_zerocopy");
+       }
+       return out;
+    }
+
+    // Drain zero-copy completions from the error queue without blocking:
+    // func(first, last, copied) for each completed range of send numbers;
+    // copied is set when the kernel fell back to copying (e.g. loopback).
+    // Returns the number of notifications, or -1 on error.
+    template<typename Func>
+    int read_zerocopy(Func&& func) const
+    {
+        int count = 0;
+        for (;;) {
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+            msghdr msg = {};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (::recvmsg(_sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+                return (errno == EAGAIN || errno == EWOULDBLOCK) ? count : -1;
+
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+                if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                    continue;
+                sock_extended_err ee;
+                memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+                if (ee.ee_errno != 0 || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    continue;
+                func(ee.ee_info, ee.ee_data, (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0);
+                ++count;
+            }
+        }
+    }
+
     int broadcast_enable() 
     {
        int optval = 1;
@@ -294,6 +1055,86 @@ public:
         }
 
 
+        // UDP segmentation offload. With GSO one send carries many same-sized
+        // datagrams (segment_size bytes each, the last may be shorter); with
+        // GRO the kernel hands back coalesced datagrams from the same flow.
+
+        int set_gso(uint16_t segment_size)
+        {
+            int optval = segment_size;
+            int out = ::setsockopt(_sockfd, SOL_UDP, UDP_SEGMENT, &optval, sizeof(optval));
+            if (out == -1) {
+                throw std::system_error(errno,std::generic_category(),"set_gso");
+            }
+            return out;
+        }
+
+        int set_gro(bool on = true)
+        {
+            int optval = on;
+            int out = ::setsockopt(_sockfd, SOL_UDP, UDP_GRO, &optval, sizeof(optval));
+            if (out == -1) {
+                throw std::system_error(errno,std::generic_category(),"set_gro");
+            }
+            return out;
+        }
+
+        // Send buf as a train of segment_size datagrams with a single system call
+        std::ptrdiff_t
+        sendto_gso(std::span<const std::byte> buf, const sockaddress<F>& remote, uint16_t segment_size, int flags = 0) const requires (type == SOCK_DGRAM)
+        {
+            iovec iov = { const_cast<std::byte*>(buf.data()), buf.size() };
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+            msghdr msg = {};
+            msg.msg_name = const_cast<sockaddr*>(&remote.c_addr());
+            msg.msg_namelen = remote.len();
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type  = UDP_SEGMENT;
+            cm->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cm), &segment_size, sizeof(uint16_t));
+
+            return ::sendmsg(_sockfd, &msg, flags);
+        }
+
+        // Receive a (possibly coalesced) buffer; segment_size is set to the
+        // size of the datagrams it contains. Split it with segment_view.
+        std::ptrdiff_t
+        recvfrom_gro(std::span<std::byte> buf, sockaddress<F>& remote, uint16_t& segment_size, int flags = 0) const requires (type == SOCK_DGRAM)
+        {
+            iovec iov = { buf.data(), buf.size() };
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+            msghdr msg = {};
+            msg.msg_name = &remote.c_addr();
+            msg.msg_namelen = remote.len();
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            auto n = ::recvmsg(_sockfd, &msg, flags);
+            if (n < 0)
+                return n;
+
+            remote.len() = msg.msg_namelen;
+            segment_size = n;
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    int gso_size;
+                    memcpy(&gso_size, CMSG_DATA(cm), sizeof(int));
+                    segment_size = gso_size;
+                }
+            }
+            return n;
+        }
+
         // Enable fanout mode (join fanout group)
         int set_fanout(int group, int mode = PACKET_FANOUT_HASH)
         {
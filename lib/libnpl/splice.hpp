@@ -0,0 +1,94 @@
+#ifndef _SPLICE_HPP_
+#define _SPLICE_HPP_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <system_error>
+#include <unistd.h>
+#include "socket.hpp"
+
+namespace npl {
+
+// Moves data between two descriptors (socket to socket for a proxy, or file
+// to socket) through a kernel pipe with splice(2), so the payload stays in
+// kernel space. Bytes taken from the source but not yet accepted by the
+// destination stay in the pipe and go out first on the next call.
+
+class splice_pipe {
+private:
+    int _rd;
+    int _wr;
+    size_t _capacity;
+    size_t _pending = 0;        // Bytes sitting in the pipe
+
+public:
+    // capacity: requested pipe size (F_SETPIPE_SZ, capped by
+    // /proc/sys/fs/pipe-max-size for unprivileged processes)
+    explicit splice_pipe(size_t capacity = 1 << 20)
+    {
+        int fds[2];
+        if (::pipe2(fds, O_CLOEXEC) == -1) {
+            throw std::system_error(errno, std::system_category(), "pipe2");
+        }
+        _rd = fds[0];
+        _wr = fds[1];
+        ::fcntl(_wr, F_SETPIPE_SZ, static_cast<int>(capacity));     // Best effort
+        int size = ::fcntl(_wr, F_GETPIPE_SZ);
+        _capacity = (size > 0) ? size : 65536;
+    }
+
+    splice_pipe(const splice_pipe&) = delete;
+    splice_pipe& operator=(const splice_pipe&) = delete;
+
+    ~splice_pipe()
+    {
+        ::close(_rd);
+        ::close(_wr);
+    }
+
+    // Move up to len bytes from in_fd to out_fd. off_in is the file offset
+    // (advanced) for a regular file, nullptr for sockets and pipes. Returns
+    // the bytes delivered to out_fd, 0 once in_fd is at EOF and the pipe is
+    // empty, -1 on error (EAGAIN with SPLICE_F_NONBLOCK: retry when ready).
+    // Senders of a long payload (a file) may add SPLICE_F_MORE, which holds
+    // partial segments as TCP_CORK does; a relay of interactive traffic must
+    // not, or each request would wait for the cork timer (~200 ms).
+    std::ptrdiff_t transfer(int in_fd, int out_fd, size_t len, loff_t* off_in = nullptr,
+                            unsigned flags = SPLICE_F_MOVE)
+    {
+        if (_pending == 0) {
+            auto n = ::splice(in_fd, off_in, _wr, nullptr, std::min(len, _capacity), flags);
+            if (n <= 0)
+                return n;
+            _pending = n;
+        }
+        auto m = ::splice(_rd, nullptr, out_fd, nullptr, _pending, flags);
+        if (m > 0)
+            _pending -= m;
+        return m;
+    }
+
+    template<int F, int T, int G, int U>
+    std::ptrdiff_t transfer(const socket<F,T>& from, const socket<G,U>& to, size_t len,
+                            unsigned flags = SPLICE_F_MOVE)
+    {
+        return this->transfer(from.fd(), to.fd(), len, nullptr, flags);
+    }
+
+    size_t pending() const
+    {
+        return _pending;
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+};
+
+}
+
+
+#endif
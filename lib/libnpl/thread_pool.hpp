@@ -0,0 +1,185 @@
+#ifndef _THREAD_POOL_HPP_
+#define _THREAD_POOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace npl {
+
+// Fixed set of worker threads (the core count by default), each with its
+// own task deque. A worker runs its newest task first (LIFO, still hot in
+// its cache); when its deque is empty it steals the oldest task of another
+// worker, so a burst submitted to one worker spreads over all of them.
+//
+// Tasks submitted from a worker go to that worker's deque, others are
+// spread round robin. Idle workers sleep on a condition variable. Tasks
+// must not throw: as with std::thread an escaping exception terminates.
+
+class thread_pool {
+public:
+    typedef std::function<void()> task;
+
+private:
+    struct alignas(64) worker {          // One cache line per deque lock
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _pending{0};     // Queued, not yet started
+    std::atomic<size_t> _next{0};        // Round robin for external submits
+    std::mutex _idle_lock;
+    std::condition_variable _idle;
+    bool _stopping = false;
+
+    struct self {
+        const thread_pool* pool = nullptr;
+        size_t index = 0;
+    };
+
+    static self& current()
+    {
+        static thread_local self s;
+        return s;
+    }
+
+    bool pop(size_t i, task& t)
+    {
+        auto& w = *_workers[i];
+        std::lock_guard<std::mutex> g(w.lock);
+        if (w.tasks.empty())
+            return false;
+        t = std::move(w.tasks.back());
+        w.tasks.pop_back();
+        return true;
+    }
+
+    // Skips the deques whose lock is busy, then waits for those locks if
+    // nothing was found: giving up would leave _pending > 0 and the caller
+    // spinning through the idle wait
+    bool steal(size_t i, task& t)
+    {
+        bool contended = false;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t k = 1; k < _workers.size(); ++k)
+            {
+                auto& w = *_workers[(i + k) % _workers.size()];
+                std::unique_lock<std::mutex> g(w.lock, std::defer_lock);
+                if (pass == 0 && !g.try_lock()) {
+                    contended = true;
+                    continue;
+                }
+                if (pass == 1)
+                    g.lock();
+                if (w.tasks.empty())
+                    continue;
+                t = std::move(w.tasks.front());
+                w.tasks.pop_front();
+                return true;
+            }
+            if (!contended)
+                break;
+        }
+        return false;
+    }
+
+    void run(size_t i)
+    {
+        current() = {this, i};
+        task t;
+        for (;;)
+        {
+            if (pop(i, t) || steal(i, t)) {
+                _pending.fetch_sub(1, std::memory_order_relaxed);
+                t();
+                t = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> g(_idle_lock);
+            _idle.wait(g, [this]() { return _stopping || _pending.load() > 0; });
+            if (_stopping && _pending.load() == 0)
+                return;
+        }
+    }
+
+public:
+    explicit thread_pool(unsigned threads = std::thread::hardware_concurrency())
+    {
+        threads = std::max(threads, 1u);
+        for (unsigned i = 0; i < threads; ++i) {
+            _workers.push_back(std::make_unique<worker>());
+        }
+        for (unsigned i = 0; i < threads; ++i) {
+            _threads.emplace_back(&thread_pool::run, this, i);
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Runs the tasks still queued, then joins the workers
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> g(_idle_lock);
+            _stopping = true;
+        }
+        _idle.notify_all();
+        for (auto& t : _threads)
+            t.join();
+    }
+
+    unsigned size() const
+    {
+        return _workers.size();
+    }
+
+    // Tasks queued and not yet started
+    size_t pending() const
+    {
+        return _pending.load(std::memory_order_relaxed);
+    }
+
+    // Index of the calling worker, or -1 outside the pool
+    int worker_index() const
+    {
+        auto& s = current();
+        return (s.pool == this) ? static_cast<int>(s.index) : -1;
+    }
+
+    void submit(task t)
+    {
+        auto& s = current();
+        size_t i = (s.pool == this) ? s.index
+                                    : _next.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+        {
+            // Counted once queued (under the deque lock, so it is never
+            // popped uncounted): idle workers wake only for a task to take
+            auto& w = *_workers[i];
+            std::lock_guard<std::mutex> g(w.lock);
+            w.tasks.push_back(std::move(t));
+            _pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        {
+            // Pairs with the predicate check in run(): no lost wake-up
+            std::lock_guard<std::mutex> g(_idle_lock);
+        }
+        _idle.notify_one();
+    }
+};
+
+}
+
+
+#endif
@@ -0,0 +1,383 @@
+#ifndef _URING_HPP_
+#define _URING_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "socket.hpp"
+
+namespace npl {
+
+// io_uring I/O engine built directly on the system calls (no liburing).
+// Operations are queued as SQEs and handed to the kernel with a single
+// io_uring_enter() per loop iteration; completions are drained in a batch.
+// Each operation carries a caller-defined 64 bit user_data tag.
+
+class uring {
+public:
+    struct completion {
+        uint64_t user_data;
+        int      res;
+        uint32_t flags;
+
+        bool more() const           // Multishot request is still armed
+        {
+            return flags & IORING_CQE_F_MORE;
+        }
+
+        bool has_buffer() const     // Data landed in a provided buffer
+        {
+            return flags & IORING_CQE_F_BUFFER;
+        }
+
+        uint16_t buffer_id() const
+        {
+            return flags >> IORING_CQE_BUFFER_SHIFT;
+        }
+    };
+
+private:
+    struct buffer_group {
+        std::byte* base = nullptr;
+        unsigned  size = 0;
+    };
+
+    int _fd = -1;
+    io_uring_params _params;
+
+    void*  _sq_ring = MAP_FAILED;
+    size_t _sq_ring_sz = 0;
+    void*  _cq_ring = MAP_FAILED;
+    size_t _cq_ring_sz = 0;
+    io_uring_sqe* _sqes = nullptr;
+    size_t _sqes_sz = 0;
+
+    unsigned* _sq_head;
+    unsigned* _sq_tail;
+    unsigned  _sq_mask;
+    unsigned  _sqe_tail = 0;        // Local tail: SQEs prepared so far
+
+    unsigned* _cq_head;
+    unsigned* _cq_tail;
+    unsigned  _cq_mask;
+    io_uring_cqe* _cqes;
+
+    std::vector<buffer_group> _groups;   // Indexed by buffer group id
+
+    static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+    }
+
+    template<typename T>
+    static T* at(void* base, unsigned offset)
+    {
+        return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+    }
+
+    io_uring_sqe* prep(uint8_t opcode, int fd, uint64_t user_data)
+    {
+        auto sqe = this->get_sqe();
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->user_data = user_data;
+        return sqe;
+    }
+
+public:
+    explicit uring(unsigned entries = 256, unsigned flags = 0)
+    {
+        memset(&_params, 0, sizeof(_params));
+        _params.flags = flags;
+        if ( (_fd = ::syscall(__NR_io_uring_setup, entries, &_params)) == -1 ) {
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+        }
+
+        _sq_ring_sz = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+        _cq_ring_sz = _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+        if (_params.features & IORING_FEAT_SINGLE_MMAP) {
+            _sq_ring_sz = _cq_ring_sz = std::max(_sq_ring_sz, _cq_ring_sz);
+        }
+
+        _sq_ring = ::mmap(nullptr, _sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) {
+            int err = errno;
+            ::close(_fd);
+            throw std::system_error(err, std::system_category(), "io_uring mmap sq");
+        }
+
+        if (_params.features & IORING_FEAT_SINGLE_MMAP) {
+            _cq_ring = _sq_ring;
+        } else {
+            _cq_ring = ::mmap(nullptr, _cq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED) {
+                int err = errno;
+                ::munmap(_sq_ring, _sq_ring_sz);
+                ::close(_fd);
+                throw std::system_error(err, std::system_category(), "io_uring mmap cq");
+            }
+        }
+
+        _sqes_sz = _params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, _sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            int err = errno;
+            if (_cq_ring != _sq_ring)
+                ::munmap(_cq_ring, _cq_ring_sz);
+            ::munmap(_sq_ring, _sq_ring_sz);
+            ::close(_fd);
+            throw std::system_error(err, std::system_category(), "io_uring mmap sqes");
+        }
+        _sqes = static_cast<io_uring_sqe*>(sqes);
+
+        _sq_head = at<unsigned>(_sq_ring, _params.sq_off.head);
+        _sq_tail = at<unsigned>(_sq_ring, _params.sq_off.tail);
+        _sq_mask = *at<unsigned>(_sq_ring, _params.sq_off.ring_mask);
+        _sqe_tail = *_sq_tail;
+
+        // Identity mapping between the SQ index array and the SQE array
+        auto array = at<unsigned>(_sq_ring, _params.sq_off.array);
+        for (unsigned i = 0; i < _params.sq_entries; ++i) {
+            array[i] = i;
+        }
+
+        _cq_head = at<unsigned>(_cq_ring, _params.cq_off.head);
+        _cq_tail = at<unsigned>(_cq_ring, _params.cq_off.tail);
+        _cq_mask = *at<unsigned>(_cq_ring, _params.cq_off.ring_mask);
+        _cqes    = at<io_uring_cqe>(_cq_ring, _params.cq_off.cqes);
+    }
+
+    uring(const uring&) = delete;
+    uring& operator=(const uring&) = delete;
+
+    ~uring()
+    {
+        ::munmap(_sqes, _sqes_sz);
+        if (_cq_ring != _sq_ring)
+            ::munmap(_cq_ring, _cq_ring_sz);
+        ::munmap(_sq_ring, _sq_ring_sz);
+        ::close(_fd);
+    }
+
+    int fd() const
+    {
+        return _fd;
+    }
+
+    unsigned features() const
+    {
+        return _params.features;
+    }
+
+    // Next free submission entry (zeroed). Submits queued entries if the SQ is full.
+    io_uring_sqe* get_sqe()
+    {
+        unsigned head = std::atomic_ref<unsigned>(*_sq_head).load(std::memory_order_acquire);
+        if (_sqe_tail - head >= _params.sq_entries) {
+            this->submit();
+            head = std::atomic_ref<unsigned>(*_sq_head).load(std::memory_order_acquire);
+            if (_sqe_tail - head >= _params.sq_entries) {
+                throw std::system_error(EBUSY, std::system_category(), "io_uring sq full");
+            }
+        }
+        auto sqe = &_sqes[_sqe_tail & _sq_mask];
+        ++_sqe_tail;
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Operations
+
+    void accept(int fd, uint64_t user_data, bool multishot = false, int flags = SOCK_CLOEXEC)
+    {
+        auto sqe = this->prep(IORING_OP_ACCEPT, fd, user_data);
+        sqe->accept_flags = flags;
+        if (multishot)
+            sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+    }
+
+    void recv(int fd, std::span<std::byte> buf, uint64_t user_data, int flags = 0)
+    {
+        auto sqe = this->prep(IORING_OP_RECV, fd, user_data);
+        sqe->addr = reinterpret_cast<uint64_t>(buf.data());
+        sqe->len  = buf.size();
+        sqe->msg_flags = flags;
+    }
+
+    // Receive into a buffer picked by the kernel from a provided buffer group
+    void recv(int fd, uint16_t group, uint64_t user_data, bool multishot = false, int flags = 0)
+    {
+        auto sqe = this->prep(IORING_OP_RECV, fd, user_data);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = group;
+        sqe->msg_flags = flags;
+        if (multishot)
+            sqe->ioprio |= IORING_RECV_MULTISHOT;
+    }
+
+    void send(int fd, std::span<const std::byte> buf, uint64_t user_data, int flags = 0)
+    {
+        auto sqe = this->prep(IORING_OP_SEND, fd, user_data);
+        sqe->addr = reinterpret_cast<uint64_t>(buf.data());
+        sqe->len  = buf.size();
+        sqe->msg_flags = flags;
+    }
+
+    // Datagram sockets: msghdr (and the buffers it points to) must stay valid until completion
+    void recvmsg(int fd, msghdr* msg, uint64_t user_data, int flags = 0)
+    {
+        auto sqe = this->prep(IORING_OP_RECVMSG, fd, user_data);
+        sqe->addr = reinterpret_cast<uint64_t>(msg);
+        sqe->len  = 1;
+        sqe->msg_flags = flags;
+    }
+
+    void sendmsg(int fd, const msghdr* msg, uint64_t user_data, int flags = 0)
+    {
+        auto sqe = this->prep(IORING_OP_SENDMSG, fd, user_data);
+        sqe->addr = reinterpret_cast<uint64_t>(msg);
+        sqe->len  = 1;
+        sqe->msg_flags = flags;
+    }
+
+    void close(int fd, uint64_t user_data)
+    {
+        this->prep(IORING_OP_CLOSE, fd, user_data);
+    }
+
+    // Completes with -ETIME once ts has elapsed; ts must stay valid until then
+    void timeout(const __kernel_timespec* ts, uint64_t user_data)
+    {
+        auto sqe = this->prep(IORING_OP_TIMEOUT, -1, user_data);
+        sqe->addr = reinterpret_cast<uint64_t>(ts);
+        sqe->len  = 1;
+    }
+
+    // Provided buffers: count buffers of size bytes carved out of base, handed
+    // to the kernel with IORING_OP_PROVIDE_BUFFERS (queued, not yet submitted)
+
+    static constexpr uint64_t provide_tag = ~0ULL;   // Internal requests, filtered by drain()
+
+    void provide_buffers(uint16_t group, std::byte* base, unsigned count, unsigned size)
+    {
+        if (count == 0 || count > 65536) {
+            throw std::system_error(EINVAL, std::system_category(), "provide_buffers: bad buffer count");
+        }
+        if (group >= _groups.size()) {
+            _groups.resize(group + 1);
+        }
+        _groups[group].base = base;
+        _groups[group].size = size;
+
+        auto sqe = this->prep(IORING_OP_PROVIDE_BUFFERS, count, provide_tag);
+        sqe->addr = reinterpret_cast<uint64_t>(base);
+        sqe->len  = size;
+        sqe->off  = 0;
+        sqe->buf_group = group;
+    }
+
+    std::span<std::byte> buffer(uint16_t group, uint16_t bid) const
+    {
+        auto& g = _groups[group];
+        return std::span<std::byte>(g.base + static_cast<size_t>(bid) * g.size, g.size);
+    }
+
+    // Give a buffer back to the kernel: travels with the next submit(). No CQE
+    // on success where the kernel can skip it (IORING_FEAT_CQE_SKIP, 5.17);
+    // on older kernels the CQE is posted and filtered by drain().
+    void recycle_buffer(uint16_t group, uint16_t bid)
+    {
+        auto& g = _groups[group];
+        auto sqe = this->prep(IORING_OP_PROVIDE_BUFFERS, 1, provide_tag);
+        sqe->addr = reinterpret_cast<uint64_t>(g.base + static_cast<size_t>(bid) * g.size);
+        sqe->len  = g.size;
+        sqe->off  = bid;
+        sqe->buf_group = group;
+        if (_params.features & IORING_FEAT_CQE_SKIP)
+            sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+    }
+
+    // Submission and completion
+
+    // Publish queued SQEs and optionally wait for wait_nr completions. Returns
+    // the SQEs consumed by the kernel. Those it did not take (short submit, or
+    // -1 with errno EAGAIN/EBUSY: out of resources or CQ overflowing) stay
+    // queued and go with the next submit(), after reaping completions.
+    int submit(unsigned wait_nr = 0)
+    {
+        std::atomic_ref<unsigned>(*_sq_tail).store(_sqe_tail, std::memory_order_release);
+        unsigned head = std::atomic_ref<unsigned>(*_sq_head).load(std::memory_order_acquire);
+        unsigned to_submit = _sqe_tail - head;          // Not consumed by the kernel yet
+
+        if (to_submit == 0 && wait_nr == 0)
+            return 0;
+
+        int out = enter(_fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (out == -1) {
+            if (errno == EINTR)
+                return 0;
+            if (errno == EAGAIN || errno == EBUSY)
+                return -1;
+            throw std::system_error(errno, std::system_category(), "io_uring_enter");
+        }
+        return out;
+    }
+
+    // Hand every available completion to func, then release them all at once
+    template<typename F>
+    unsigned drain(F&& func)
+    {
+        unsigned head = *_cq_head;
+        unsigned tail = std::atomic_ref<unsigned>(*_cq_tail).load(std::memory_order_acquire);
+        unsigned n = 0;
+        for (; head != tail; ++head, ++n) {
+            const auto& cqe = _cqes[head & _cq_mask];
+            if (cqe.user_data == provide_tag) {
+                if (cqe.res < 0) {
+                    std::atomic_ref<unsigned>(*_cq_head).store(head + 1, std::memory_order_release);
+                    throw std::system_error(-cqe.res, std::system_category(), "io_uring provide buffers");
+                }
+                continue;
+            }
+            func(completion{cqe.user_data, cqe.res, cqe.flags});
+        }
+        std::atomic_ref<unsigned>(*_cq_head).store(head, std::memory_order_release);
+        return n;
+    }
+
+    // One loop iteration: submit everything queued, wait for at least one
+    // completion, drain. If the kernel was busy and nothing could be reaped,
+    // wait for a completion (EBUSY: the overflowed ones) or back off briefly
+    // (EAGAIN) before the next iteration submits again.
+    template<typename F>
+    unsigned run_once(F&& func)
+    {
+        int out = this->submit(1);
+        int err = errno;
+        unsigned n = this->drain(func);
+        if (out == -1 && n == 0) {
+            if (err == EBUSY)
+                enter(_fd, 0, 1, IORING_ENTER_GETEVENTS);
+            else
+                ::usleep(1000);
+            n = this->drain(func);
+        }
+        return n;
+    }
+};
+
+}
+
+
+#endif
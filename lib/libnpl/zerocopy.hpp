@@ -0,0 +1,155 @@
+#ifndef _ZEROCOPY_HPP_
+#define _ZEROCOPY_HPP_
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <vector>
+#include <sys/socket.h>
+#include "socket.hpp"
+
+namespace npl {
+
+// Fixed set of page-aligned send buffers for MSG_ZEROCOPY. A buffer is
+// acquired, filled, sent (possibly in several calls, after a short send),
+// then released by the caller; it only becomes free again once the kernel
+// has reported every send that used it as complete (reap()). acquire()
+// returning nullopt means all buffers are in flight: wait for POLLERR (or
+// just reap) and retry.
+//
+// The socket needs set_zerocopy() and must be used for MSG_ZEROCOPY sends
+// through this pool only, since completions are matched by send number.
+
+class zerocopy_pool {
+private:
+    size_t _buf_size;
+    std::byte* _mem;
+    std::vector<uint32_t> _free;
+    std::vector<uint32_t> _refs;            // Sends in flight, per buffer
+    std::vector<bool> _held;                // Acquired, not yet released
+    std::deque<std::pair<uint32_t, uint32_t>> _inflight;   // (send number, buffer)
+    uint32_t _next_seq = 0;
+    uint64_t _completed = 0;
+    uint64_t _copied = 0;
+
+    void maybe_free(uint32_t id)
+    {
+        if (!_held[id] && _refs[id] == 0)
+            _free.push_back(id);
+    }
+
+public:
+    zerocopy_pool(size_t count, size_t buf_size)
+    : _buf_size((buf_size + 4095) & ~size_t(4095))
+    , _refs(count, 0)
+    , _held(count, false)
+    {
+        _mem = static_cast<std::byte*>(std::aligned_alloc(4096, count * _buf_size));
+        if (_mem == nullptr) {
+            throw std::bad_alloc();
+        }
+        for (uint32_t i = count; i > 0; --i) {
+            _free.push_back(i - 1);
+        }
+    }
+
+    zerocopy_pool(const zerocopy_pool&) = delete;
+    zerocopy_pool& operator=(const zerocopy_pool&) = delete;
+
+    // The kernel may still read buffers in flight: close the socket first
+    ~zerocopy_pool()
+    {
+        std::free(_mem);
+    }
+
+    std::optional<uint32_t> acquire()
+    {
+        if (_free.empty())
+            return std::nullopt;
+        auto id = _free.back();
+        _free.pop_back();
+        _held[id] = true;
+        return id;
+    }
+
+    std::span<std::byte> data(uint32_t id)
+    {
+        return std::span<std::byte>(_mem + id * _buf_size, _buf_size);
+    }
+
+    // Send len bytes of buffer id from offset off with MSG_ZEROCOPY.
+    // Returns what send() returns; ENOBUFS means too much is pinned (see
+    // net.core.optmem_max): reap and retry.
+    template<int F, int type>
+    std::ptrdiff_t send(const socket<F,type>& sock, uint32_t id, size_t off, size_t len, int flags = 0)
+    {
+        auto n = sock.send(data(id).subspan(off, len), flags | MSG_ZEROCOPY);
+        if (n > 0) {
+            _inflight.emplace_back(_next_seq++, id);
+            ++_refs[id];
+        }
+        return n;
+    }
+
+    // The caller is done with id; it is recycled once its sends complete
+    void release(uint32_t id)
+    {
+        _held[id] = false;
+        maybe_free(id);
+    }
+
+    // Process completions from the error queue. Returns the number of
+    // notifications read, -1 on error.
+    template<int F, int type>
+    int reap(const socket<F,type>& sock)
+    {
+        return sock.read_zerocopy([this](uint32_t first, uint32_t last, bool copied) {
+            _copied += copied;
+            // Ranges arrive in order for a stream socket: retire from the front
+            while (!_inflight.empty() && _inflight.front().first - first <= last - first) {
+                auto id = _inflight.front().second;
+                _inflight.pop_front();
+                --_refs[id];
+                ++_completed;
+                maybe_free(id);
+            }
+        });
+    }
+
+    size_t buffer_size() const
+    {
+        return _buf_size;
+    }
+
+    size_t in_flight() const
+    {
+        return _inflight.size();
+    }
+
+    size_t available() const
+    {
+        return _free.size();
+    }
+
+    // Sends completed so far, and notifications where the kernel copied anyway
+    uint64_t completed() const
+    {
+        return _completed;
+    }
+
+    uint64_t copied() const
+    {
+        return _copied;
+    }
+};
+
+}
+
+
+#endif
@@ -0,0 +1,171 @@
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <span>
+#include <splice.hpp>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <iostream>
+
+// File server on the TCPsrv accept loop (one process per client). A client
+// sends a file name terminated by '\n'; the server answers with the file
+// size as 8 bytes big-endian followed by the file. A file that cannot be
+// opened (missing, not a regular file, bad name) is answered with size
+// 2^64 - 1 and nothing else, so that an empty file (size 0) is told apart.
+// Names are looked up in <dir> only (no '/' allowed).
+//
+//   FILEsrv <dir> [sendfile|splice|copy]
+//
+// sendfile and splice keep the payload in the kernel; copy is the
+// read()/write() loop through a user buffer. Each transfer prints its rate.
+
+enum class mode { sendfile, splice, copy };
+
+constexpr uint64_t not_found = ~uint64_t{0};
+
+std::ptrdiff_t send_copy(const npl::socket<AF_INET, SOCK_STREAM>& sock, int fd, size_t len)
+{
+    npl::buffer buff(1 << 17);
+    std::ptrdiff_t tot_sent = 0;
+    while (static_cast<size_t>(tot_sent) < len) {
+        auto n = ::read(fd, buff.data(), std::min(buff.size(), len - tot_sent));
+        if (n <= 0)
+            break;
+        if (sock.writen(std::as_bytes(std::span(buff).first(n))) != n)
+            return -1;
+        tot_sent += n;
+    }
+    return tot_sent;
+}
+
+std::ptrdiff_t send_splice(const npl::socket<AF_INET, SOCK_STREAM>& sock, int fd, size_t len)
+{
+    npl::splice_pipe pipe;
+    loff_t offset = 0;
+    std::ptrdiff_t tot_sent = 0;
+    while (static_cast<size_t>(tot_sent) < len) {
+        auto n = pipe.transfer(fd, sock.fd(), len - tot_sent, &offset, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == 0)
+            break;
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        tot_sent += n;
+    }
+    return tot_sent;
+}
+
+void serve(npl::socket<AF_INET, SOCK_STREAM>& connected_sock, const std::string& dir, mode m)
+{
+    // Requests until the client closes
+    std::string name;
+    char c;
+    while (connected_sock.read(std::as_writable_bytes(std::span(&c, 1))) == 1)
+    {
+        if (c != '\n') {
+            name.push_back(c);
+            continue;
+        }
+
+        int fd = -1;
+        struct stat st = {};
+        if (!name.empty() && name.find('/') == std::string::npos && name != "." && name != "..") {
+            fd = ::open((dir + "/" + name).c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd != -1 && (::fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        uint64_t size = (fd == -1) ? not_found : st.st_size;
+        uint64_t hdr = htobe64(size);
+        if (fd != -1)
+            connected_sock.set_cork();      // Header leaves with the first file segment
+        if (connected_sock.writen(std::as_bytes(std::span(&hdr, 1))) != sizeof(hdr)) {
+            if (fd != -1) {
+                ::close(fd);
+                connected_sock.set_cork(false);
+            }
+            break;
+        }
+
+        if (fd != -1) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::ptrdiff_t n;
+            switch (m) {
+                case mode::sendfile: n = connected_sock.sendfilen(fd, 0, size); break;
+                case mode::splice:   n = send_splice(connected_sock, fd, size); break;
+                default:             n = send_copy(connected_sock, fd, size); break;
+            }
+            ::close(fd);
+            connected_sock.set_cork(false);
+            auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            std::cout << name << ": " << n << " of " << size << " bytes, "
+                      << n / secs / (1 << 20) << " MB/s" << std::endl;
+            if (n != static_cast<std::ptrdiff_t>(size))
+                break;
+        }
+        name.clear();
+    }
+    connected_sock.close();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <dir> [sendfile|splice|copy]" << std::endl;
+        return (1);
+    }
+
+    int port=12000;
+    std::string dir(argv[1]);
+    std::string how = (argc > 2) ? argv[2] : "sendfile";
+    mode m = (how == "splice") ? mode::splice : (how == "copy") ? mode::copy : mode::sendfile;
+
+    npl::sockaddress<AF_INET> srv_addr(port);
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    sock.set_reuseaddr();
+    sock.bind(srv_addr);
+    sock.listen(SOMAXCONN);
+
+    // Reap exited children as they go; SA_RESTART resumes the interrupted accept
+    struct sigaction sa = {};
+    sa.sa_handler = [](int) {
+        int saved = errno;
+        while (waitpid(-1, nullptr, WNOHANG) > 0) {}
+        errno = saved;
+    };
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, nullptr);
+
+    std::cout << "Serving " << dir << " on port " << port << " (" << how << ")" << std::endl;
+
+    for(;;) {
+        auto [connected_sock,client] = sock.accept();
+        std::cout << "Connected to client " << client.host() << " Port " << client.port() << std::endl;
+
+        if (fork() == 0)
+        {
+            sock.close();
+            serve(connected_sock, dir, m);
+            std::exit(EXIT_SUCCESS);
+        }
+        connected_sock.close();
+    }
+
+    sock.close();
+
+    return EXIT_SUCCESS;
+}
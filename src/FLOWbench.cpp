@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <flow_table.hpp>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <iostream>
+
+// Fill npl::flow_table with synthetic TCP flows (both directions of each),
+// look them up, expire the idle ones, then repeat the updates on a
+// sharded_flow_table from several threads. Prints rates and bytes per flow.
+
+npl::flow_key make_key(uint32_t i, bool reply)
+{
+    uint32_t a = htonl(0x0a000000 + i);                 // Unique per flow
+    uint32_t b = htonl(0xc0a80000 + (i * 7) % 65536);
+    uint16_t pa = 1024 + i % 50000, pb = 443;
+    return reply ? npl::flow_key(b, a, pb, pa, IPPROTO_TCP) : npl::flow_key(a, b, pa, pb, IPPROTO_TCP);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t nflows = (argc > 1) ? std::atoi(argv[1]) : 10000000;
+    unsigned nthreads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+
+    using clock = std::chrono::steady_clock;
+    auto rate = [](uint64_t ops, auto d) {
+        return ops / std::chrono::duration<double, std::micro>(d).count();
+    };
+
+    npl::flow_table table(nflows);
+    std::cout << nflows << " flows: " << table.capacity() << " slots, "
+              << table.memory() / (1 << 20) << " MiB, "
+              << static_cast<double>(table.memory()) / nflows << " bytes/flow" << std::endl;
+
+    // Timestamps spread the flows over 10 seconds of capture time
+    uint32_t per_sec = nflows / 10 + 1;
+
+    auto t0 = clock::now();
+    for (uint32_t i = 0; i < nflows; ++i)
+        table.update(make_key(i, false), 1500, i / per_sec);
+    auto t1 = clock::now();
+
+    // Replies in batches of 64, prefetching the slots of the whole batch first
+    // (as done for a block of frames out of a packet_ring)
+    std::vector<npl::flow_key> keys(64);
+    std::vector<uint64_t> hashes(64);
+    for (uint32_t i = 0; i < nflows; i += 64) {
+        uint32_t n = std::min<uint32_t>(64, nflows - i);
+        for (uint32_t j = 0; j < n; ++j) {
+            keys[j] = make_key(i + j, true);
+            hashes[j] = keys[j].hash();
+            table.prefetch(hashes[j]);
+        }
+        for (uint32_t j = 0; j < n; ++j)
+            table.update(keys[j], hashes[j], 64, (i + j) / per_sec);
+    }
+    auto t1b = clock::now();
+
+    uint64_t found = 0;
+    for (uint32_t i = 0; i < nflows; ++i)
+        found += (table.find(make_key(i, i & 1)) != nullptr);
+    auto t2 = clock::now();
+
+    auto expired = table.expire(10, 5);
+    auto t3 = clock::now();
+
+    std::cout << "update : " << rate(nflows, t1 - t0) << " M/s (" << table.size() + expired << " flows)" << std::endl;
+    std::cout << "update batched with prefetch : " << rate(nflows, t1b - t1) << " M/s" << std::endl;
+    std::cout << "find   : " << rate(nflows, t2 - t1b) << " M/s (" << found << " found)" << std::endl;
+    std::cout << "expire : " << expired << " idle flows in "
+              << std::chrono::duration<double, std::milli>(t3 - t2).count() << " ms, "
+              << table.size() << " left" << std::endl;
+
+    // Sharded: each thread updates its own slice of flows, both directions
+    npl::sharded_flow_table shared(nflows);
+    std::vector<std::thread> workers;
+    auto t4 = clock::now();
+    for (unsigned w = 0; w < nthreads; ++w) {
+        workers.emplace_back([&shared, w, nthreads, nflows, per_sec]() {
+            for (uint32_t i = w; i < nflows; i += nthreads) {
+                shared.update(make_key(i, false), 1500, i / per_sec);
+                shared.update(make_key(i, true), 64, i / per_sec);
+            }
+        });
+    }
+    for (auto& t : workers)
+        t.join();
+    auto t5 = clock::now();
+
+    std::cout << "sharded update (" << nthreads << " threads): " << rate(2ULL * nflows, t5 - t4)
+              << " M/s (" << shared.size() << " flows, " << shared.memory() / (1 << 20) << " MiB)" << std::endl;
+
+    return (found == nflows) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
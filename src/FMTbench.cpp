@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <headers.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <iostream>
+
+// Format the MAC and IPv4 addresses of synthetic frames three ways: the
+// former stringstream / inet_ntop path, the std::string returning header
+// methods, and the header methods writing into caller buffers.
+
+std::string legacy_mac(const u_int8_t* mac)
+{
+    std::stringstream ss;
+    ss << std::hex << static_cast<uint16_t>(mac[0]);
+    std::for_each(mac + 1, mac + 6, [&ss](uint8_t x) { ss << ":" << std::hex << static_cast<uint16_t>(x); });
+    return ss.str();
+}
+
+std::string legacy_ipv4(const in_addr& a)
+{
+    char addr[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &a, addr, sizeof(addr));
+    return addr;
+}
+
+int main(int argc, char* argv[])
+{
+    int rounds = (argc > 1) ? std::atoi(argv[1]) : 200;
+    constexpr size_t nframes = 1024;
+    constexpr size_t frame_len = sizeof(ether_header) + sizeof(ip);
+
+    std::vector<u_int8_t> frames(nframes * frame_len);
+    std::mt19937 rng(7);
+    std::generate(frames.begin(), frames.end(), [&rng]() { return static_cast<u_int8_t>(rng()); });
+
+    std::vector<npl::header<hdr::ether>> eth;
+    std::vector<npl::header<hdr::ipv4>> ip4;
+    for (size_t i = 0; i < nframes; ++i) {
+        const u_int8_t* p = frames.data() + i * frame_len;
+        eth.emplace_back(p, sizeof(ether_header));
+        ip4.emplace_back(p + sizeof(ether_header), sizeof(ip));
+    }
+
+    uint64_t total = rounds * nframes;
+    using clock = std::chrono::steady_clock;
+    auto ns = [total](auto d) {
+        return std::chrono::duration<double, std::nano>(d).count() / total;
+    };
+
+    size_t len1 = 0;
+    auto t0 = clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < nframes; ++i) {
+            auto e = eth[i].c_hdr();
+            auto a = ip4[i].c_hdr();
+            len1 += legacy_mac(e.ether_shost).size() + legacy_mac(e.ether_dhost).size();
+            len1 += legacy_ipv4(a.ip_src).size() + legacy_ipv4(a.ip_dst).size();
+        }
+    }
+
+    size_t len2 = 0;
+    auto t1 = clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < nframes; ++i) {
+            len2 += eth[i].src_mac().size() + eth[i].dst_mac().size();
+            len2 += ip4[i].src().size() + ip4[i].dst().size();
+        }
+    }
+
+    size_t len3 = 0;
+    char mac[npl::MAC_STRLEN], addr[npl::IPV4_STRLEN];
+    auto t2 = clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < nframes; ++i) {
+            len3 += eth[i].src_mac(mac).size() + eth[i].dst_mac(mac).size();
+            len3 += ip4[i].src(addr).size() + ip4[i].dst(addr).size();
+        }
+    }
+    auto t3 = clock::now();
+
+    std::cout << "2 MAC + 2 IPv4 per frame, " << total << " frames" << std::endl;
+    std::cout << "stringstream / inet_ntop : " << ns(t1 - t0) << " ns/frame" << std::endl;
+    std::cout << "tables, std::string      : " << ns(t2 - t1) << " ns/frame" << std::endl;
+    std::cout << "tables, caller buffer    : " << ns(t3 - t2) << " ns/frame" << std::endl;
+    std::cout << "e.g. " << eth[0].src_mac() << " " << ip4[0].src()
+              << " (was " << legacy_mac(eth[0].c_hdr().ether_shost) << ")" << std::endl;
+
+    // Same IPv4 text; MACs now always print two digits per octet
+    return (len2 == len3) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <packet.hpp>
+#include <pcapfile.hpp>
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#ifdef NPL_HAVE_LIBPCAP
+#include <pcap.hpp>
+#endif
+
+// Walk a pcap trace and parse every frame with npl::packet, through the
+// memory-mapped reader, a stdio reader that copies each record (what
+// pcap_next does) and, when built with libpcap, reader<offline>::loop.
+// Without a file argument a synthetic trace is written first.
+
+struct result {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t tcp = 0;
+
+    void account(const u_int8_t* data, u_int32_t caplen)
+    {
+        npl::packet<hdr::ether> pkt(data, caplen);
+        ++packets;
+        bytes += caplen;
+        tcp += pkt.has<hdr::tcp>();
+    }
+};
+
+void make_trace(const std::string& path, unsigned npackets)
+{
+    npl::pcap::writer out(path);
+    std::vector<u_int8_t> frame(1514, 0);
+    frame[12] = 0x08;                                       // IPv4 / TCP
+    frame[14] = 0x45;
+    frame[23] = IPPROTO_TCP;
+    frame[14 + 20 + 12] = 0x50;
+    std::mt19937 rng(1);
+    for (unsigned i = 0; i < npackets; ++i) {
+        u_int32_t caplen = 64 + rng() % 1450;
+        out.write(i / 100000, (i % 100000) * 10, caplen, caplen, frame.data());
+    }
+}
+
+result run_mapped(const std::string& path)
+{
+    result res;
+    npl::pcap::mapped_reader in(path);
+    in.loop([&res](const npl::pcap::record& r) { res.account(r.data, r.caplen); });
+    return res;
+}
+
+result run_stdio(const std::string& path)
+{
+    result res;
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return res;
+    npl::pcap::file_header fh;
+    npl::pcap::record_header rh;
+    std::vector<u_int8_t> buf(1 << 18);
+    if (std::fread(&fh, sizeof(fh), 1, f) == 1) {
+        while (std::fread(&rh, sizeof(rh), 1, f) == 1 && rh.caplen <= buf.size() &&
+               std::fread(buf.data(), 1, rh.caplen, f) == rh.caplen) {
+            res.account(buf.data(), rh.caplen);
+        }
+    }
+    std::fclose(f);
+    return res;
+}
+
+#ifdef NPL_HAVE_LIBPCAP
+result run_libpcap(const std::string& path)
+{
+    result res;
+    npl::pcap::reader<offline> in(path);
+    auto func = [&res](const struct pcap_pkthdr* h, const u_char* bytes) { res.account(bytes, h->caplen); };
+    in.loop(func);
+    return res;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    std::string path = (argc > 1) ? argv[1] : "/tmp/npl-bench.pcap";
+    if (argc < 2) {
+        make_trace(path, 1000000);
+    }
+
+    auto run = [](const char* name, auto func) {
+        func();                                             // Warm the page cache
+        auto t0 = std::chrono::steady_clock::now();
+        auto res = func();
+        auto d = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << name << res.packets / d / 1e6 << " Mpkt/s " << res.bytes / d / (1 << 30) << " GiB/s"
+                  << " (" << res.packets << " packets, " << res.tcp << " TCP)" << std::endl;
+    };
+
+    run("mapped_reader    : ", [&path]() { return run_mapped(path); });
+    run("stdio, copied    : ", [&path]() { return run_stdio(path); });
+#ifdef NPL_HAVE_LIBPCAP
+    run("reader<offline>  : ", [&path]() { return run_libpcap(path); });
+#else
+    std::cout << "reader<offline>  : not built (libpcap not found)" << std::endl;
+#endif
+
+    if (argc < 2)
+        std::remove(path.c_str());
+
+    return EXIT_SUCCESS;
+}
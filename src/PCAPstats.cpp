@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <decoder.hpp>
+#include <flow_table.hpp>
+#include <format.hpp>
+#include <pcapfile.hpp>
+#include <pcapindex.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <iostream>
+
+// Per-flow and per-protocol statistics of a pcap trace, computed on several
+// threads: the trace is cut at record boundaries into chunks (the index is
+// saved as <file>.idx for the next run), each worker decodes whole chunks in
+// frame_batch blocks into its own flow_table, and the tables are merged at
+// the end. Without a file argument a synthetic trace is written first.
+
+struct stats {
+    npl::flow_table flows;
+    npl::frame_batch<64> batch;
+    std::array<u_int32_t, 64> ts;
+    std::array<u_int32_t, 64> len;
+    uint64_t packets = 0, bytes = 0;
+    uint64_t ipv4 = 0, ipv6 = 0, tcp = 0, udp = 0, dropped = 0;
+
+    explicit stats(size_t max_flows)
+    : flows(max_flows)
+    {}
+
+    void add(const npl::pcap::record& r)
+    {
+        ts[batch.count] = r.sec;
+        len[batch.count] = r.len;
+        batch.add(r.data, std::min<u_int32_t>(r.caplen, UINT16_MAX));
+        ++packets;
+        bytes += r.len;
+        if (batch.full())
+            flush();
+    }
+
+    void flush()
+    {
+        npl::decode(batch);
+
+        std::array<npl::flow_key, 64> keys;
+        std::array<uint64_t, 64> hashes;
+        std::array<bool, 64> valid;
+        for (size_t i = 0; i < batch.count; ++i) {
+            ipv4 += batch.ethertype[i] == ETHERTYPE_IP;
+            ipv6 += batch.ethertype[i] == ETHERTYPE_IPV6;
+            tcp  += batch.l4_proto[i] == IPPROTO_TCP;
+            udp  += batch.l4_proto[i] == IPPROTO_UDP;
+            auto k = npl::flow_key::from(batch, i);
+            valid[i] = k.has_value();
+            if (valid[i]) {
+                keys[i] = *k;
+                hashes[i] = k->hash();
+                flows.prefetch(hashes[i]);
+            }
+        }
+        for (size_t i = 0; i < batch.count; ++i) {
+            if (valid[i] && flows.update(keys[i], hashes[i], len[i], ts[i]) == nullptr)
+                ++dropped;
+        }
+        batch.clear();
+    }
+};
+
+std::string endpoint(const in6_addr& a, u_int16_t port)
+{
+    char buf[npl::IPV6_STRLEN + 2];
+    if (IN6_IS_ADDR_V4MAPPED(&a)) {
+        u_int32_t v4;
+        std::memcpy(&v4, &a.s6_addr[12], sizeof(v4));
+        npl::format_ipv4(v4, buf);
+        return std::string(buf) + ":" + std::to_string(port);
+    }
+    npl::format_ipv6(a, buf);
+    return "[" + std::string(buf) + "]:" + std::to_string(port);
+}
+
+void make_trace(const std::string& path, unsigned npackets, unsigned nflows)
+{
+    npl::pcap::writer out(path);
+    std::vector<u_int8_t> v4(1514, 0), v6(1514, 0);
+    v4[12] = 0x08;                                          // IPv4 / TCP or UDP
+    v4[14] = 0x45;
+    v6[12] = 0x86; v6[13] = 0xdd;                           // IPv6 / UDP
+    v6[14] = 0x60;
+    v6[20] = IPPROTO_UDP;
+    std::mt19937 rng(1);
+    for (unsigned i = 0; i < npackets; ++i) {
+        u_int32_t flow = rng() % nflows;
+        u_int16_t sport = htons(1024 + flow % 60000), dport = htons(443);
+        u_int32_t caplen = 64 + rng() % 1450;
+        if (flow % 8 == 0) {
+            std::memcpy(&v6[14 + 8 + 12], &flow, sizeof(flow));
+            std::memcpy(&v6[14 + 40], &sport, 2);
+            std::memcpy(&v6[14 + 42], &dport, 2);
+            out.write(i / 100000, (i % 100000) * 10, caplen, caplen, v6.data());
+        } else {
+            u_int32_t src = htonl(0x0a000000 + flow);
+            v4[23] = (flow % 3) ? IPPROTO_TCP : IPPROTO_UDP;
+            std::memcpy(&v4[26], &src, 4);
+            std::memcpy(&v4[34], &sport, 2);
+            std::memcpy(&v4[36], &dport, 2);
+            out.write(i / 100000, (i % 100000) * 10, caplen, caplen, v4.data());
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string path = (argc > 1) ? argv[1] : "/tmp/npl-stats.pcap";
+    unsigned nthreads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    size_t chunk_mb   = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : 64;
+    size_t max_flows  = (argc > 4) ? std::strtoull(argv[4], nullptr, 10) : 1 << 20;
+    nthreads = std::max(nthreads, 1u);
+
+    if (argc < 2) {
+        make_trace(path, 4000000, 200000);
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+    auto idx = npl::pcap::chunk_index::open(path, std::max<size_t>(chunk_mb, 1) << 20);
+    auto t1 = clock::now();
+
+    auto parts = npl::pcap::parallel_walk(path, idx, nthreads,
+        [max_flows](unsigned) { return stats(max_flows); },
+        [](stats& s, const npl::pcap::record& r) { s.add(r); });
+    auto t2 = clock::now();
+
+    // Merge into the first worker's table
+    auto& total = parts[0];
+    for (size_t w = 1; w < parts.size(); ++w) {
+        auto& p = parts[w];
+        total.dropped += total.flows.merge(p.flows) + p.dropped;
+        total.packets += p.packets; total.bytes += p.bytes;
+        total.ipv4 += p.ipv4; total.ipv6 += p.ipv6;
+        total.tcp += p.tcp; total.udp += p.udp;
+    }
+    auto t3 = clock::now();
+
+    std::vector<npl::flow> top;
+    total.flows.for_each([&top](const npl::flow& f) { top.push_back(f); });
+    auto n = std::min<size_t>(top.size(), 10);
+    std::partial_sort(top.begin(), top.begin() + n, top.end(),
+                      [](const npl::flow& a, const npl::flow& b) { return a.bytes > b.bytes; });
+
+    auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    auto secs = std::chrono::duration<double>(t2 - t1).count();
+
+    std::cout << path << ": " << idx.chunks() << " chunks of " << chunk_mb << " MB, "
+              << nthreads << " threads" << std::endl;
+    std::cout << total.packets << " packets, " << total.bytes << " bytes | IPv4 " << total.ipv4
+              << " IPv6 " << total.ipv6 << " TCP " << total.tcp << " UDP " << total.udp << std::endl;
+    std::cout << total.flows.size() << " flows (" << total.dropped << " dropped, table full)" << std::endl;
+    std::cout << "index " << ms(t1 - t0) << " ms, walk " << ms(t2 - t1) << " ms ("
+              << total.packets / secs / 1e6 << " Mpkt/s), merge " << ms(t3 - t2) << " ms" << std::endl;
+
+    std::cout << "top flows by bytes:" << std::endl;
+    for (size_t i = 0; i < n; ++i) {
+        auto& f = top[i];
+        std::cout << "  " << static_cast<int>(f.key.proto) << " " << endpoint(f.key.lo_addr, f.key.lo_port)
+                  << " <-> " << endpoint(f.key.hi_addr, f.key.hi_port) << "  "
+                  << f.packets << " pkts " << f.bytes << " bytes" << std::endl;
+    }
+
+    if (argc < 2) {
+        std::remove(path.c_str());
+        std::remove((path + ".idx").c_str());
+    }
+
+    return EXIT_SUCCESS;
+}
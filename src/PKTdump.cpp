@@ -0,0 +1,62 @@
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <packet_ring.hpp>
+#include <pcapfile.hpp>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <string>
+#include <iostream>
+
+// Capture through a TPACKET_V3 ring straight into pcap files, rotating every
+// <MB> megabytes. Stop with Ctrl-C. Needs CAP_NET_RAW.
+
+volatile std::sig_atomic_t stop = 0;
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " <interface> <file.pcap> [rotate MB] [direct]" << std::endl;
+        return (1);
+    }
+
+    std::string ifname(argv[1]);
+    npl::pcap::writer::options opt;
+    opt.nanosecond   = true;                  // The ring has nanosecond timestamps
+    opt.rotate_bytes = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) << 20 : 0;
+    opt.direct       = (argc > 4) && std::strcmp(argv[4], "direct") == 0;
+
+    npl::socket<AF_PACKET, SOCK_RAW> sock(htons(ETH_P_ALL));
+    npl::packet_ring ring(sock);
+    sock.bind(npl::sockaddress<AF_PACKET>(ifname));
+
+    npl::pcap::writer out(argv[2], opt);
+    std::signal(SIGINT, [](int) { stop = 1; });
+    std::signal(SIGTERM, [](int) { stop = 1; });
+
+    uint64_t last_pkts = 0, last_bytes = 0;
+    auto last = std::chrono::steady_clock::now();
+
+    while (!stop)
+    {
+        ring.dispatch([&out](const npl::packet_ring::frame& f) { out.write(f); }, 1000);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last >= std::chrono::seconds(1)) {
+            auto st = ring.stats();
+            std::cout << out.current_file() << ": " << out.packets() - last_pkts << " pkt/s "
+                      << (out.bytes() - last_bytes) * 8 / 1e6 << " Mbit/s to disk"
+                      << " | kernel drops " << st.tp_drops << std::endl;
+            last_pkts = out.packets();
+            last_bytes = out.bytes();
+            last = now;
+        }
+    }
+
+    out.close();
+    std::cout << out.packets() << " packets in " << out.files() << " file(s)" << std::endl;
+
+    return EXIT_SUCCESS;
+}
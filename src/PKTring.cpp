@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <packet.hpp>
+#include <packet_ring.hpp>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <string>
+#include <iostream>
+
+// Capture through a TPACKET_V3 ring and parse every frame with npl::packet,
+// printing rates and kernel drops once per second. Needs CAP_NET_RAW.
+
+int main(int argc, char* argv[])
+{
+    std::string ifname = (argc > 1) ? argv[1] : "lo";
+
+    npl::socket<AF_PACKET, SOCK_RAW> sock(htons(ETH_P_ALL));
+    npl::packet_ring ring(sock);
+    sock.bind(npl::sockaddress<AF_PACKET>(ifname));
+
+    uint64_t pkts = 0, bytes = 0, ipv4 = 0, ipv6 = 0, tcp = 0, udp = 0;
+    auto last = std::chrono::steady_clock::now();
+
+    for(;;)
+    {
+        ring.dispatch([&](const npl::packet_ring::frame& f) {
+            npl::packet<hdr::ether> pkt(f.data(), std::min<u_int32_t>(f.caplen(), UINT16_MAX));   // Defragmented frames may exceed 64 KB
+            ++pkts;
+            bytes += f.len();
+            ipv4 += pkt.has<hdr::ipv4>();
+            ipv6 += pkt.has<hdr::ipv6>();
+            tcp  += pkt.has<hdr::tcp>();
+            udp  += pkt.has<hdr::udp>();
+        }, 1000);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last >= std::chrono::seconds(1)) {
+            auto st = ring.stats();
+            std::cout << ifname << ": " << pkts << " pkt/s " << bytes * 8 / 1e6 << " Mbit/s"
+                      << " IPv4 " << ipv4 << " IPv6 " << ipv6 << " TCP " << tcp << " UDP " << udp
+                      << " | kernel: " << st.tp_packets << " received " << st.tp_drops << " dropped" << std::endl;
+            pkts = bytes = ipv4 = ipv6 = tcp = udp = 0;
+            last = now;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
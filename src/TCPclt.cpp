@@ -1,13 +1,74 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <framed_stream.hpp>
 #include <socket.hpp>
 #include <sockaddress.hpp>
 #include <string>
 #include <sys/socket.h>
 #include <iostream>
 
+// Line client for the echo servers. Interactive by default: each line typed
+// is sent with its '\n' and the reply read back up to its '\n', however the
+// stream is segmented. With a depth, it benchmarks pipelining instead:
+// depth requests are written at once, then their replies read, repeated
+// until all requests are answered. With a size as well, requests are
+// size-byte messages with a 2-byte length prefix, for TCPlpsrv.
+
+int pipelined(npl::socket<AF_INET,SOCK_STREAM>& sock, int depth, int requests, int size)
+{
+    using stream = npl::framed_stream<AF_INET,SOCK_STREAM>;
+    bool lp = (size >= 0);
+    npl::framed_stream in(sock, lp ? stream::length_prefix(2) : stream::delimited('\n'));
+    npl::buffer out;
+    std::string msg(lp ? size : 0, 'x');
+    int done = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    while (done < requests)
+    {
+        int n = std::min(depth, requests - done);
+        out.clear();
+        for (int i = 0; i < n; ++i) {
+            if (lp) {
+                in.append_frame(out, std::as_bytes(std::span(msg)));
+                continue;
+            }
+            auto req = "request " + std::to_string(done + i);
+            in.append_frame(out, std::as_bytes(std::span(req)));
+        }
+        if (sock.writen(std::as_bytes(std::span(out))) != static_cast<std::ptrdiff_t>(out.size())) {
+            std::cerr << "write failed" << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < n; ++i) {
+            auto reply = in.read_frame();
+            bool ok = reply && (lp ? reply->size() == msg.size() && (msg.empty() || (*reply)[0] == std::byte{'X'})
+                                   : !reply->empty() && (*reply)[0] == std::byte{'R'});
+            if (!ok) {
+                std::cerr << "bad or missing reply " << done + i << std::endl;
+                return 1;
+            }
+        }
+        done += n;
+    }
+    auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "depth " << depth << ": " << requests / secs << " req/s, "
+              << secs * 1e6 / ((requests + depth - 1) / depth) << " us per round trip" << std::endl;
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
     if (argc < 3) {
-        std::cout << "Usage: " << argv[0] << " <server> <port>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <server> <port> [depth [requests [size]]]" << std::endl;
+        return (1);
+    }
+
+    int size = (argc > 5) ? std::atoi(argv[5]) : -1;
+    if (argc > 5 && (size < 0 || size > UINT16_MAX)) {
+        std::cout << "Usage: " << argv[0] << " <server> <port> [depth [requests [size 0 to " << UINT16_MAX << "]]]" << std::endl;
         return (1);
     }
 
@@ -20,6 +81,15 @@ int main(int argc, char* argv[])
 
     sock.connect(srv_addr);
 
+    if (argc > 3) {
+        int depth = std::max(std::atoi(argv[3]), 1);
+        int requests = (argc > 4) ? std::atoi(argv[4]) : 100000;
+        auto rc = pipelined(sock, depth, requests, size);
+        sock.close();
+        return rc;
+    }
+
+    npl::framed_stream in(sock, npl::framed_stream<AF_INET,SOCK_STREAM>::delimited('\n'));
     std::string line;
 
     for(;;)
@@ -28,14 +98,15 @@ int main(int argc, char* argv[])
         if (line.empty())
             break;
 
-        npl::buffer buff(line.begin(),line.end());
-        sock.write(buff);
-        npl::buffer response = sock.read(80);
-        std::cout << std::string(response.begin(),response.end()) << std::endl;
+        in.write_frame(std::as_bytes(std::span(line)));
+        auto response = in.read_frame();
+        if (!response)
+            break;
+        std::cout << std::string(reinterpret_cast<const char*>(response->data()), response->size()) << std::endl;
     }
 
     sock.close();
 
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <coro.hpp>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <span>
+#include <sys/socket.h>
+#include <iostream>
+
+// TCPmt with one coroutine per client instead of one thread: the same
+// blocking-style loop, all clients served by one thread on npl::scheduler.
+
+npl::task<> reply_to_clt(npl::scheduler& loop, npl::socket<AF_INET, SOCK_STREAM> connected, npl::sockaddress<AF_INET> client)
+{
+    npl::buffer buff(80);    // Reused for the whole connection
+    for(;;)
+    {
+        auto n = co_await connected.async_read(loop, std::as_writable_bytes(std::span(buff)));
+        if (n <= 0)
+            break;
+        std::transform(buff.begin(),buff.begin()+n,buff.begin(),::toupper);
+
+        auto reply = std::as_bytes(std::span(buff).first(n));
+        while (!reply.empty()) {
+            auto w = co_await connected.async_write(loop, reply);
+            if (w <= 0)
+                break;
+            reply = reply.subspan(w);
+        }
+        if (!reply.empty())
+            break;
+    }
+    std::cout << "Disconnected from client " << client.host() << std::endl;
+    loop.release(connected);
+    connected.close();
+}
+
+npl::task<> acceptor(npl::scheduler& loop, npl::socket<AF_INET, SOCK_STREAM>& sock)
+{
+    for(;;)
+    {
+        bool failed = false;
+        try {
+            auto [connected_sock,client] = co_await sock.async_accept(loop);
+            std::cout << "Connected to client " << client.host() << " Port " << client.port() << std::endl;
+            loop.spawn(reply_to_clt(loop, std::move(connected_sock), client));
+        }
+        catch (const std::system_error& e) {
+            std::cerr << e.what() << std::endl;     // e.g. EMFILE: keep accepting
+            failed = true;
+        }
+        // The error would repeat at once: let the clients run (and maybe
+        // close some fds) before trying again
+        if (failed)
+            co_await loop.sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+int main()
+{
+    int port=12000;
+    npl::sockaddress<AF_INET> srv_addr(port);
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    sock.set_reuseaddr();
+    sock.bind(srv_addr);
+    sock.listen(SOMAXCONN);
+    sock.set_nonblocking();
+
+    npl::scheduler loop;
+    loop.spawn(acceptor(loop, sock));
+    loop.run();
+
+    sock.close();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <buffered_writer.hpp>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <reactor.hpp>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <span>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <vector>
+#include <iostream>
+
+// Replies are gathered per connection and flushed at the end of the reactor
+// tick: all the requests read in one round are answered with one write.
+struct connection {
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    npl::sockaddress<AF_INET> client;
+    npl::buffered_writer<AF_INET, SOCK_STREAM> out;
+    bool flush_queued = false;
+    bool waiting_out = false;   // Interest switched to EPOLLOUT
+    bool eof = false;           // Client done sending: close once the replies are out
+
+    connection(npl::socket<AF_INET, SOCK_STREAM>&& s, const npl::sockaddress<AF_INET>& peer)
+    : sock(std::move(s))
+    , client(peer)
+    , out(sock)
+    {}
+};
+
+int main()
+{
+    int port=12000;
+    npl::sockaddress<AF_INET> srv_addr(port);
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    sock.set_reuseaddr();
+    sock.bind(srv_addr);
+    sock.listen(SOMAXCONN);
+    sock.set_nonblocking();
+
+    npl::reactor loop;
+    std::vector<std::unique_ptr<connection>> conns;   // Indexed by fd
+    npl::buffer buff(80);                             // Shared: single thread
+
+    auto disconnect = [&](int fd) {
+        std::cout << "Disconnected from client " << conns[fd]->client.host() << std::endl;
+        loop.remove(fd);
+        conns[fd].reset();
+    };
+
+    // Send the gathered replies; switch interest to EPOLLOUT while the socket
+    // is full. After EOF, disconnect once everything is sent.
+    auto flush = [&](int fd) {
+        auto& c = *conns[fd];
+        c.flush_queued = false;
+        auto r = c.out.flush();
+        if (!r && !r.would_block()) {
+            disconnect(fd);
+            return;
+        }
+        bool full = c.out.pending() > 0;
+        if (c.eof && !full) {
+            disconnect(fd);
+            return;
+        }
+        if (full != c.waiting_out) {
+            c.waiting_out = full;
+            loop.modify(fd, full ? EPOLLOUT : EPOLLIN);
+        }
+    };
+
+    auto on_client = [&](int fd, uint32_t events) {
+        if (events & EPOLLOUT) {
+            flush(fd);
+            return;
+        }
+        // Take what the client has queued (a few reads, to stay fair), then
+        // reply to all of it with one flush
+        auto& c = *conns[fd];
+        for (int i = 0; i < 16; ++i) {
+            auto r = c.sock.try_read(std::as_writable_bytes(std::span(buff)));
+            if (r.closed()) {
+                if (!r.ok()) {
+                    disconnect(fd);
+                    return;
+                }
+                c.eof = true;           // EOF: answer what came before it
+                flush(fd);
+                return;
+            }
+            if (!r)
+                break;
+            auto n = r.bytes;
+            std::transform(buff.begin(),buff.begin()+n,buff.begin(),::toupper);
+
+            auto w = c.out.write(std::as_bytes(std::span(buff).first(n)));
+            if (!w && !w.would_block()) {
+                disconnect(fd);
+                return;
+            }
+            if (n < static_cast<std::ptrdiff_t>(buff.size()))
+                break;
+        }
+        if (!c.flush_queued) {
+            c.flush_queued = true;
+            loop.defer([&flush, &conns, fd] {
+                if (conns[fd] && conns[fd]->flush_queued)
+                    flush(fd);
+            });
+        }
+    };
+
+    // Accept the whole backlog; new sockets come out non-blocking
+    loop.add(sock, EPOLLIN, [&](uint32_t) {
+        for (;;) {
+            auto a = sock.try_accept();
+            if (!a) {
+                if (!a.status.would_block())
+                    std::cerr << "accept: " << std::strerror(a.status.error) << std::endl;
+                break;
+            }
+            std::cout << "Connected to client " << a.peer.host() << " Port " << a.peer.port() << std::endl;
+
+            int fd = a.sock->fd();
+            if (static_cast<size_t>(fd) >= conns.size()) {
+                conns.resize(fd + 1);
+            }
+            conns[fd] = std::make_unique<connection>(std::move(*a.sock), a.peer);
+            loop.add(fd, EPOLLIN, [&on_client, fd](uint32_t events) { on_client(fd, events); });
+        }
+    });
+
+    loop.run();
+
+    sock.close();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <span>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <iostream>
+
+// TCPsrv with length-prefixed messages: each message is a 2-byte big-endian
+// length followed by that many bytes, echoed back uppercased with the same
+// framing. By default the reply header and payload go out with one writev;
+// "copy" builds each reply in a fresh buffer instead (the previous way).
+// Per-connection message rate is printed on disconnect.
+
+void serve(npl::socket<AF_INET, SOCK_STREAM>& connected_sock, const npl::sockaddress<AF_INET>& client, bool copy)
+{
+    npl::buffer payload(UINT16_MAX);
+    uint16_t hdr;
+    uint64_t messages = 0, bytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+
+    connected_sock.set_nodelay();       // Replies are whole writes: Nagle would only delay pipelined ones
+
+    for(;;)
+    {
+        auto h = connected_sock.readn(std::as_writable_bytes(std::span(&hdr, 1)));
+        if (h != sizeof(hdr))
+            break;
+        size_t len = ntohs(hdr);
+        if (connected_sock.readn(std::as_writable_bytes(std::span(payload).first(len))) != static_cast<std::ptrdiff_t>(len))
+            break;
+        std::transform(payload.begin(),payload.begin()+len,payload.begin(),::toupper);
+
+        std::ptrdiff_t w;
+        if (copy) {
+            npl::buffer reply(sizeof(hdr) + len);
+            std::memcpy(reply.data(), &hdr, sizeof(hdr));
+            std::copy(payload.begin(), payload.begin()+len, reply.begin()+sizeof(hdr));
+            w = connected_sock.writen(std::as_bytes(std::span(reply)));
+        } else {
+            iovec iov[] = { npl::as_iovec(std::as_bytes(std::span(&hdr, 1))),
+                            npl::as_iovec(std::as_bytes(std::span(payload).first(len))) };
+            w = connected_sock.writevn(iov);
+        }
+        if (w != static_cast<std::ptrdiff_t>(sizeof(hdr) + len))
+            break;
+        ++messages;
+        bytes += len;
+    }
+
+    auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "Disconnected from client " << client.host() << ": " << messages << " messages, "
+              << bytes << " bytes, " << messages / secs << " msg/s" << std::endl;
+    connected_sock.close();
+}
+
+int main(int argc, char* argv[])
+{
+    int port=12000;
+    bool copy = (argc > 1) && std::strcmp(argv[1], "copy") == 0;
+
+    npl::sockaddress<AF_INET> srv_addr(port);
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    sock.set_reuseaddr();
+    sock.bind(srv_addr);
+    sock.listen(SOMAXCONN);
+
+    struct sigaction sa = {};
+    sa.sa_handler = [](int) {
+        int saved = errno;
+        while (waitpid(-1, nullptr, WNOHANG) > 0) {}
+        errno = saved;
+    };
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, nullptr);
+
+    std::cout << "Serving port " << port << (copy ? " (copying replies)" : " (writev replies)") << std::endl;
+
+    for(;;) {
+        auto [connected_sock,client] = sock.accept();
+
+        if (fork() == 0)
+        {
+            sock.close();
+            serve(connected_sock, client, copy);
+            std::exit(EXIT_SUCCESS);
+        }
+        connected_sock.close();
+    }
+
+    sock.close();
+
+    return EXIT_SUCCESS;
+}
@@ -1,22 +1,50 @@
 #include <algorithm>
+#include <buffered_writer.hpp>
 #include <cstdlib>
 #include <socket.hpp>
 #include <sockaddress.hpp>
+#include <span>
 #include <sys/socket.h>
 #include <thread>
 #include <iostream>
 
+// Replies are gathered in a buffered_writer and flushed once the client has
+// nothing more queued: a pipelined burst is answered with one write instead
+// of one per read, and never waits for Nagle (the writer sets TCP_NODELAY).
+// A short read means the input is drained, so flush at once (read + write
+// per echo, as before); after a full one, read on without blocking and
+// flush only when that would block.
 void reply_to_clt(npl::socket<AF_INET, SOCK_STREAM> connected, npl::sockaddress<AF_INET> client)
 {           
+    npl::buffer buff(80);    // Reused for the whole connection
+    npl::buffered_writer out(connected);
+    bool more = false;       // Last read filled buff: more input is likely queued
     for(;;)
     {
-        auto buff = connected.read(80);
-        if (buff.empty())
+        std::ptrdiff_t n;
+        if (more) {
+            auto r = connected.try_recv(std::as_writable_bytes(std::span(buff)));
+            if (r.would_block()) {
+                if (!out.flush())
+                    break;
+                more = false;
+                continue;
+            }
+            n = r.ok() ? r.bytes : -1;
+        } else {
+            n = connected.read(std::as_writable_bytes(std::span(buff)));
+        }
+        if (n <= 0)
+            break;
+        std::transform(buff.begin(),buff.begin()+n,buff.begin(),::toupper);
+        if (!out.write(std::as_bytes(std::span(buff).first(n))))
+            break;
+        more = (n == static_cast<std::ptrdiff_t>(buff.size()));
+        if (!more && !out.flush())
             break;
-        std::transform(buff.begin(),buff.end(),buff.begin(),::toupper);
-        connected.write(buff);
     }    
-    std::cout << "Disconnected from client " << client.host() << std::endl;
+    out.flush();             // Replies to what came before EOF
+    std::cout << "Disconnected from client " << client.host() << " (" << out.writes() << " writes)" << std::endl;
     connected.close();
 }
 
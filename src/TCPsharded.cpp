@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <reactor.hpp>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <span>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+struct connection {
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    npl::sockaddress<AF_INET> client;
+    npl::buffer pending;
+};
+
+struct alignas(64) shard_stats {       // One cache line per shard: no false sharing
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> connections{0};
+};
+
+// One event loop with its own listening socket, pinned to one CPU
+void shard(int port, int cpu, shard_stats& stats)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus); err != 0) {
+        std::cerr << "shard not pinned to cpu " << cpu << ": " << std::strerror(err) << std::endl;
+    }
+
+    npl::sockaddress<AF_INET> srv_addr(port);
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    sock.set_reuseaddr();
+    sock.set_reuseport();
+    sock.bind(srv_addr);
+    sock.listen(SOMAXCONN);
+    sock.set_nonblocking();
+
+    npl::reactor loop;
+    std::vector<std::unique_ptr<connection>> conns;
+    npl::buffer buff(80);
+
+    auto disconnect = [&](int fd) {
+        loop.remove(fd);
+        conns[fd].reset();
+        stats.connections.fetch_sub(1, std::memory_order_relaxed);
+    };
+
+    // Try to send pending bytes; switch interest to EPOLLOUT while the socket is full
+    auto flush = [&](int fd) {
+        auto& c = *conns[fd];
+        auto r = c.sock.try_write(std::as_bytes(std::span(c.pending)));
+        if (r.closed()) {
+            disconnect(fd);
+            return;
+        }
+        c.pending.erase(c.pending.begin(), c.pending.begin() + r.bytes);
+        if (c.pending.empty())
+            loop.modify(fd, EPOLLIN);
+    };
+
+    auto on_client = [&](int fd, uint32_t events) {
+        if (events & EPOLLOUT) {
+            flush(fd);
+            return;
+        }
+        auto& c = *conns[fd];
+        auto r = c.sock.try_read(std::as_writable_bytes(std::span(buff)));
+        if (r.closed()) {
+            disconnect(fd);
+            return;
+        }
+        if (!r)
+            return;
+        auto n = r.bytes;
+        std::transform(buff.begin(),buff.begin()+n,buff.begin(),::toupper);
+        stats.messages.fetch_add(1, std::memory_order_relaxed);
+        stats.bytes.fetch_add(n, std::memory_order_relaxed);
+
+        // Reply straight from the shared buffer: only a short write is copied aside
+        auto w = c.sock.try_write(std::as_bytes(std::span(buff).first(n)));
+        if (w.closed()) {
+            disconnect(fd);
+            return;
+        }
+        if (w.bytes < n) {
+            c.pending.assign(buff.begin()+w.bytes,buff.begin()+n);
+            loop.modify(fd, EPOLLOUT);
+        }
+    };
+
+    // Accept the whole backlog; new sockets come out non-blocking
+    loop.add(sock, EPOLLIN, [&](uint32_t) {
+        for (;;) {
+            auto a = sock.try_accept();
+            if (!a) {
+                if (!a.status.would_block())
+                    std::cerr << "accept: " << std::strerror(a.status.error) << std::endl;
+                break;
+            }
+            int fd = a.sock->fd();
+            if (static_cast<size_t>(fd) >= conns.size()) {
+                conns.resize(fd + 1);
+            }
+            conns[fd] = std::make_unique<connection>(connection{std::move(*a.sock), a.peer, {}});
+            loop.add(fd, EPOLLIN, [&on_client, fd](uint32_t events) { on_client(fd, events); });
+            stats.connections.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    loop.run();
+}
+
+int main(int argc, char* argv[])
+{
+    int port=12000;
+    int ncpu = std::max(1u, std::thread::hardware_concurrency());     // 0 if unknown
+    int nthreads = (argc > 1) ? std::atoi(argv[1]) : ncpu;
+
+    if (nthreads <= 0) {
+        std::cout << "Usage: " << argv[0] << " [threads]" << std::endl;
+        return (1);
+    }
+
+    std::vector<shard_stats> stats(nthreads);
+    std::vector<std::thread> shards;
+    for (int i = 0; i < nthreads; ++i) {
+        shards.emplace_back(shard, port, i % ncpu, std::ref(stats[i]));
+    }
+
+    std::cout << "Serving port " << port << " with " << nthreads << " shards" << std::endl;
+
+    // Report per-shard (per-core) throughput once per second
+    struct snapshot { uint64_t messages = 0, bytes = 0; };
+    std::vector<snapshot> last(nthreads);
+    for(;;)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t total = 0, total_bytes = 0;
+        for (int i = 0; i < nthreads; ++i) {
+            snapshot now = {stats[i].messages.load(std::memory_order_relaxed),
+                            stats[i].bytes.load(std::memory_order_relaxed)};
+            std::cout << "cpu " << i % ncpu << ": " << (now.messages - last[i].messages) << " msg/s "
+                      << (now.bytes - last[i].bytes) / 1024 << " KB/s "
+                      << stats[i].connections.load(std::memory_order_relaxed) << " conn  ";
+            total += now.messages - last[i].messages;
+            total_bytes += now.bytes - last[i].bytes;
+            last[i] = now;
+        }
+        std::cout << "| total " << total << " msg/s " << total_bytes / 1024 << " KB/s" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,18 +1,196 @@
 #include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <socket.hpp>
 #include <sockaddress.hpp>
+#include <span>
 #include <sys/socket.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
 #include <iostream>
 
-int main()
+// Uppercase echo server, one process per client.
+//
+//   TCPsrv          fork a child for every accepted connection
+//   TCPsrv <N>      pre-fork N workers that all accept on the listening
+//                   socket and serve one connection at a time; the parent
+//                   only reaps and respawns them
+//
+// Children are reaped on SIGCHLD, so none is left as a zombie.
+
+void serve(npl::socket<AF_INET, SOCK_STREAM>& connected_sock, const npl::sockaddress<AF_INET>& client)
+{
+    npl::buffer buff(80);    // Reused for the whole connection
+    for(;;)
+    {
+        auto n = connected_sock.read(std::as_writable_bytes(std::span(buff)));
+        if (n <= 0)
+            break;
+        std::transform(buff.begin(),buff.begin()+n,buff.begin(),::toupper);
+        connected_sock.write(std::as_bytes(std::span(buff).first(n)));
+    }
+    std::cout << "Disconnected from client " << client.host() << std::endl;
+    connected_sock.close();
+}
+
+// Pre-forked worker: never returns
+[[noreturn]] void worker(npl::socket<AF_INET, SOCK_STREAM>& sock)
+{
+    for(;;) {
+        try {
+            auto [connected_sock,client] = sock.accept();
+            std::cout << "[" << getpid() << "] Connected to client " << client.host() << " Port " << client.port() << std::endl;
+            serve(connected_sock, client);
+        }
+        catch (const std::system_error& e) {
+            if (e.code().value() != EINTR && e.code().value() != ECONNABORTED)
+                std::cerr << "[" << getpid() << "] " << e.what() << std::endl;
+        }
+    }
+}
+
+pid_t spawn(npl::socket<AF_INET, SOCK_STREAM>& sock, const sigset_t& parent_mask)
+{
+    auto pid = fork();
+    if (pid == -1) {
+        throw std::system_error(errno, std::system_category(), "fork");
+    }
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &parent_mask, nullptr);
+        std::signal(SIGCHLD, SIG_DFL);
+        worker(sock);
+    }
+    return pid;
+}
+
+// A worker that exits within min_uptime of its start, or whose fork fails,
+// is started again only after respawn_delay: one that cannot serve (accept
+// failing on every call, a crash in serve) is not re-forked in a tight loop
+constexpr auto min_uptime = std::chrono::seconds(1);
+constexpr auto respawn_delay = std::chrono::seconds(1);
+
+struct worker_slot {
+    pid_t pid = -1;                                     // -1: waiting for respawn_at
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point respawn_at;
+};
+
+void prefork(npl::socket<AF_INET, SOCK_STREAM>& sock, int nworkers)
+{
+    using clock = std::chrono::steady_clock;
+
+    // The supervisor takes SIGCHLD/SIGINT/SIGTERM synchronously with sigwait
+    sigset_t mask, parent_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, &parent_mask);
+
+    auto start = [&](worker_slot& w) {
+        try {
+            w.pid = spawn(sock, parent_mask);
+            w.started = clock::now();
+        }
+        catch (const std::system_error& e) {
+            std::cerr << "Supervisor: " << e.what() << ", retrying in "
+                      << respawn_delay.count() << " s" << std::endl;
+            w.pid = -1;
+            w.respawn_at = clock::now() + respawn_delay;
+        }
+    };
+
+    std::vector<worker_slot> workers(nworkers);
+    for (auto& w : workers) {
+        start(w);
+    }
+    std::cout << "Supervisor " << getpid() << ": " << nworkers << " workers" << std::endl;
+
+    for(;;) {
+        // Wait for a signal, or until the next delayed respawn is due
+        int sig = 0;
+        auto next = clock::time_point::max();
+        for (auto& w : workers) {
+            if (w.pid == -1)
+                next = std::min(next, w.respawn_at);
+        }
+        if (next == clock::time_point::max()) {
+            sigwait(&mask, &sig);
+        } else {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(next - clock::now()).count();
+            ns = std::max<decltype(ns)>(ns, 0);
+            timespec ts = { static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000) };
+            sig = sigtimedwait(&mask, nullptr, &ts);         // -1 on timeout (EAGAIN) or EINTR
+        }
+
+        if (sig == SIGINT || sig == SIGTERM) {
+            for (auto& w : workers) {
+                if (w.pid > 0)
+                    kill(w.pid, SIGTERM);
+            }
+            while (waitpid(-1, nullptr, 0) > 0) {}
+            return;
+        }
+
+        // One SIGCHLD may stand for several exits
+        pid_t pid;
+        int status;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            auto w = std::find_if(workers.begin(), workers.end(), [pid](const worker_slot& s) { return s.pid == pid; });
+            if (w == workers.end())
+                continue;
+            bool fast = clock::now() - w->started < min_uptime;
+            std::cout << "Worker " << pid << (WIFSIGNALED(status) ? " killed by signal " : " exited with status ")
+                      << (WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status)) << ", respawning";
+            if (fast)
+                std::cout << " in " << respawn_delay.count() << " s";
+            std::cout << std::endl;
+            w->pid = -1;
+            w->respawn_at = fast ? clock::now() + respawn_delay : clock::now();
+        }
+
+        auto now = clock::now();
+        for (auto& w : workers) {
+            if (w.pid == -1 && w.respawn_at <= now)
+                start(w);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
 {
     int port=12000;
+    int nworkers = (argc > 1) ? std::atoi(argv[1]) : 0;
+
     npl::sockaddress<AF_INET> srv_addr(port);
     npl::socket<AF_INET, SOCK_STREAM> sock;
+    sock.set_reuseaddr();
     sock.bind(srv_addr);
-    sock.listen();
+    sock.listen(SOMAXCONN);
+
+    if (nworkers > 0) {
+        prefork(sock, nworkers);
+        sock.close();
+        return EXIT_SUCCESS;
+    }
+
+    // Reap exited children as they go; SA_RESTART resumes the interrupted accept
+    struct sigaction sa = {};
+    sa.sa_handler = [](int) {
+        int saved = errno;
+        while (waitpid(-1, nullptr, WNOHANG) > 0) {}
+        errno = saved;
+    };
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, nullptr);
 
     for(;;) {
         auto [connected_sock,client] = sock.accept();
@@ -20,17 +198,17 @@ int main()
 
         auto pid = fork();
 
+        if (pid == -1) {    // Drop this client, keep accepting
+            std::cerr << "fork: " << std::strerror(errno) << std::endl;
+            connected_sock.close();
+            continue;
+        }
+
         if (pid == 0)   // Sono nel processo figlio
         {
-            for(;;)
-            {
-                npl::buffer buff = connected_sock.read(80);
-                if (buff.empty())
-                    break;
-                std::transform(buff.begin(),buff.end(),buff.begin(),::toupper);
-                connected_sock.write(buff);
-            }
-        std::cout << "Disconnected from client " << client.host() << std::endl;
+            sock.close();
+            serve(connected_sock, client);
+            std::exit(EXIT_SUCCESS);
         }
         connected_sock.close();
     }
@@ -38,4 +216,4 @@ int main()
     sock.close();
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 #include <cstdlib>
 #include <socket.hpp>
 #include <sockaddress.hpp>
+#include <span>
 #include <sys/socket.h>
 #include <iostream>
 
@@ -20,13 +21,14 @@ int main()
         auto [connected_sock,client] = sock.accept();
         std::cout << "Connected to client " << client.host() << " Port " << client.port() << std::endl;
 
+        npl::buffer buff(80);    // Reused for the whole connection
         for(;;)
         {
-            npl::buffer buff = connected_sock.read(80);
-            if (buff.empty())
+            auto n = connected_sock.read(std::as_writable_bytes(std::span(buff)));
+            if (n <= 0)
                 break;
-            std::transform(buff.begin(),buff.end(),buff.begin(),::toupper);
-            connected_sock.write(buff);
+            std::transform(buff.begin(),buff.begin()+n,buff.begin(),::toupper);
+            connected_sock.write(std::as_bytes(std::span(buff).first(n)));
         }
 
         connected_sock.close();
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <sys/socket.h>
+#include <uring.hpp>
+#include <vector>
+#include <iostream>
+
+// user_data layout: | fd (32) | buffer id (16) | unused (8) | op (8) |
+enum op : uint8_t { op_accept, op_recv, op_send, op_close, op_timer };
+
+constexpr uint64_t tag(op o, int fd = 0, uint16_t bid = 0)
+{
+    return (static_cast<uint64_t>(fd) << 32) | (static_cast<uint64_t>(bid) << 16) | o;
+}
+
+constexpr uint16_t BGID  = 0;
+constexpr unsigned NBUFS = 4096;
+constexpr unsigned BUFSZ = 80;
+
+struct connection {
+    std::vector<std::pair<uint16_t,uint16_t>> outq;  // (buffer id, length) waiting to be sent
+    uint16_t sent = 0;                                // Bytes of outq.front() already sent
+    bool sending = false;
+    bool receiving = true;
+    bool closing = false;
+    bool parked = false;                              // Waiting for free buffers, no recv armed
+};
+
+int main()
+{
+    int port=12000;
+    npl::sockaddress<AF_INET> srv_addr(port);
+    npl::socket<AF_INET, SOCK_STREAM> sock;
+    sock.set_reuseaddr();
+    sock.bind(srv_addr);
+    sock.listen(SOMAXCONN);
+
+    npl::uring ring(1024);
+    std::vector<std::byte> pool(NBUFS * BUFSZ);
+    ring.provide_buffers(BGID, pool.data(), NBUFS, BUFSZ);
+
+    std::vector<connection> conns;
+    bool multishot = true;     // Cleared if the kernel rejects multishot requests
+
+    ring.accept(sock.fd(), tag(op_accept), multishot);
+
+    // Out of buffers (ENOBUFS): the connection is parked and its recv re-armed
+    // only after some buffer has been given back
+    std::vector<int> parked;
+    bool recycled = false;
+
+    auto give_back = [&](uint16_t bid) {
+        ring.recycle_buffer(BGID, bid);
+        recycled = true;
+    };
+
+    auto resume_parked = [&]() {
+        for (int fd : parked) {
+            auto& c = conns[fd];
+            if (c.parked) {
+                c.parked = false;
+                ring.recv(fd, BGID, tag(op_recv, fd), multishot);
+            }
+        }
+        parked.clear();
+    };
+
+    // Out of descriptors (EMFILE, ENFILE) or memory: accepting again at once
+    // would only fail again, so accepts pause for a while
+    const __kernel_timespec accept_pause = {0, 100 * 1000 * 1000};
+
+    // The fd is closed only when no request refers to it any more
+    auto maybe_close = [&](int fd) {
+        auto& c = conns[fd];
+        if (c.closing && !c.sending && !c.receiving) {
+            for (auto [bid, len] : c.outq)
+                give_back(bid);
+            c.outq.clear();
+            ring.close(fd, tag(op_close, fd));
+        }
+    };
+
+    // Only one send in flight per connection keeps replies in order
+    auto send_next = [&](int fd) {
+        auto& c = conns[fd];
+        if (c.outq.empty()) {
+            c.sending = false;
+            maybe_close(fd);
+            return;
+        }
+        auto [bid, len] = c.outq.front();
+        auto buf = ring.buffer(BGID, bid).subspan(c.sent, len - c.sent);
+        ring.send(fd, buf, tag(op_send, fd, bid));
+        c.sending = true;
+    };
+
+    auto on_completion = [&](const npl::uring::completion& cqe) {
+        int fd = cqe.user_data >> 32;
+        switch (static_cast<op>(cqe.user_data & 0xff)) {
+
+            case op_accept:
+            {
+                if (cqe.res == -EINVAL && multishot) {
+                    multishot = false;
+                }
+                else if (cqe.res == -EMFILE || cqe.res == -ENFILE || cqe.res == -ENOBUFS || cqe.res == -ENOMEM) {
+                    if (!cqe.more()) {
+                        std::cerr << "accept: " << std::strerror(-cqe.res) << ", pausing" << std::endl;
+                        ring.timeout(&accept_pause, tag(op_timer));
+                    }
+                    break;
+                }
+                else if (cqe.res >= 0) {
+                    int cfd = cqe.res;
+                    npl::sockaddress<AF_INET> client;
+                    ::getpeername(cfd, &client.c_addr(), &client.len());
+                    std::cout << "Connected to client " << client.host() << " Port " << client.port() << std::endl;
+
+                    if (static_cast<size_t>(cfd) >= conns.size()) {
+                        conns.resize(cfd + 1);
+                    }
+                    conns[cfd] = connection();
+                    ring.recv(cfd, BGID, tag(op_recv, cfd), multishot);
+                }
+                if (!cqe.more())
+                    ring.accept(sock.fd(), tag(op_accept), multishot);
+                break;
+            }
+
+            case op_recv:
+            {
+                if (cqe.res > 0 && cqe.has_buffer()) {
+                    auto bid = cqe.buffer_id();
+                    auto buf = ring.buffer(BGID, bid).first(cqe.res);
+                    std::transform(buf.begin(), buf.end(), buf.begin(),
+                                   [](std::byte b) { return static_cast<std::byte>(::toupper(static_cast<int>(b))); });
+                    auto& c = conns[fd];
+                    if (c.closing)
+                        give_back(bid);
+                    else
+                        c.outq.emplace_back(bid, cqe.res);
+                    if (!c.sending)
+                        send_next(fd);
+                    if (!cqe.more()) {
+                        if (!c.closing) {
+                            ring.recv(fd, BGID, tag(op_recv, fd), multishot);
+                        } else {
+                            c.receiving = false;
+                            maybe_close(fd);
+                        }
+                    }
+                    break;
+                }
+                if (cqe.res == -ENOBUFS && !conns[fd].closing) {    // Buffers exhausted: park until some come back
+                    if (!cqe.more()) {
+                        conns[fd].parked = true;
+                        parked.push_back(fd);
+                    }
+                    break;
+                }
+                if (cqe.res == -EINVAL && multishot) {
+                    multishot = false;
+                    ring.recv(fd, BGID, tag(op_recv, fd), multishot);
+                    break;
+                }
+                if (!cqe.more()) {   // EOF or error
+                    std::cout << "Disconnected from client fd " << fd << std::endl;
+                    conns[fd].receiving = false;
+                    conns[fd].closing = true;
+                    maybe_close(fd);
+                }
+                break;
+            }
+
+            case op_send:
+            {
+                auto& c = conns[fd];
+                if (cqe.res < 0) {     // Peer gone: stop the pending recv as well
+                    c.closing = true;
+                    for (auto [bid, len] : c.outq)
+                        give_back(bid);
+                    c.outq.clear();
+                    c.sent = 0;
+                    if (c.parked) {            // No recv to wait for
+                        c.parked = false;
+                        c.receiving = false;
+                    }
+                    ::shutdown(fd, SHUT_RDWR);
+                    send_next(fd);
+                    break;
+                }
+                auto [bid, len] = c.outq.front();
+                c.sent += cqe.res;
+                if (c.sent == len) {
+                    give_back(bid);
+                    c.outq.erase(c.outq.begin());
+                    c.sent = 0;
+                }
+                send_next(fd);
+                break;
+            }
+
+            case op_close:
+                break;
+
+            case op_timer:
+                ring.accept(sock.fd(), tag(op_accept), multishot);
+                break;
+        }
+    };
+
+    // Every iteration submits all the SQEs queued while handling the previous batch
+    for(;;)
+    {
+        ring.run_once(on_completion);
+        if (recycled && !parked.empty())
+            resume_parked();
+        recycled = false;
+    }
+
+    sock.close();
+
+    return EXIT_SUCCESS;
+}
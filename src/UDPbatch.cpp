@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <iostream>
+#include <sys/socket.h>
+
+// Batched variant of UDPsrv: a whole batch of requests is received with one
+// recvmmsg() and answered in place with one sendmmsg()
+
+int main(int argc, char* argv[]) {
+    auto srv_port=10000;
+    int batch_size = (argc > 1) ? std::atoi(argv[1]) : 64;
+    if (batch_size < 1 || batch_size > IOV_MAX) {      // recvmmsg takes at most UIO_MAXIOV (= IOV_MAX) messages
+        std::cout << "Usage: " << argv[0] << " [batch size, 1 to " << IOV_MAX << "]" << std::endl;
+        return (1);
+    }
+
+    npl::socket<AF_INET, SOCK_DGRAM> sock;
+    npl::sockaddress<AF_INET> srv_addr(srv_port);
+    sock.bind(srv_addr);
+
+    npl::dgram_batch<AF_INET> batch(batch_size, 80);
+
+    for(;;) {
+        int n = sock.recv_batch(batch);
+        if (n <= 0)
+            continue;
+
+        for (int i = 0; i < n; ++i) {
+            auto text = batch.payload(i);
+            std::transform(text.begin(),text.end(),text.begin(),
+                           [](std::byte b) { return static_cast<std::byte>(::toupper(static_cast<int>(b))); });
+        }
+
+        sock.send_batch(batch, n);
+    }
+
+    sock.close();
+
+
+    return EXIT_SUCCESS;
+}
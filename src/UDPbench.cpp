@@ -0,0 +1,67 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <iostream>
+
+// Loopback packets/sec versus batch size: one thread sends 80 byte datagrams
+// with send_batch, another drains them with recv_batch, for one second per size
+
+int main(int argc, char* argv[])
+{
+    int port = (argc > 1) ? std::atoi(argv[1]) : 10001;
+    npl::sockaddress<AF_INET> dst("127.0.0.1", port);
+
+    std::cout << "batch\tsent pps\treceived pps" << std::endl;
+
+    for (int b : {1, 2, 4, 8, 16, 32, 64, 128})
+    {
+        npl::socket<AF_INET, SOCK_DGRAM> rx;
+        rx.set_reuseaddr();
+        rx.bind(dst);
+        int rcvbuf = 8 << 20;
+        rx.setsockopt(SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        timeval tv = {0, 100000};
+        rx.setsockopt(SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        std::atomic<bool> stop{false};
+        uint64_t received = 0;
+        std::thread receiver([&]() {
+            npl::dgram_batch<AF_INET> in(b, 80);
+            while (!stop.load(std::memory_order_relaxed)) {
+                int n = rx.recv_batch(in);
+                if (n > 0)
+                    received += n;
+            }
+        });
+
+        npl::socket<AF_INET, SOCK_DGRAM> tx;
+        npl::dgram_batch<AF_INET> out(b, 80);
+        for (int i = 0; i < b; ++i) {
+            out.addr(i) = dst;
+            out.set_len(i, 80);
+        }
+
+        uint64_t sent = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration<double>(0);
+        while (elapsed.count() < 1.0) {
+            int n = tx.send_batch(out, b);
+            if (n > 0)
+                sent += n;
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        stop = true;
+        receiver.join();
+
+        std::cout << b << "\t" << static_cast<uint64_t>(sent / elapsed.count())
+                  << "\t" << static_cast<uint64_t>(received / elapsed.count()) << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
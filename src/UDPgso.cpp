@@ -0,0 +1,82 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <socket.hpp>
+#include <sockaddress.hpp>
+#include <span>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+// Loopback comparison of per-datagram sendto() against GSO sends of
+// SEGMENTS datagrams per call. The receiver has GRO enabled and splits
+// what it gets back into datagrams with segment_view.
+
+constexpr uint16_t SEGMENT  = 1400;
+constexpr int      SEGMENTS = 40;    // 56000 bytes per GSO send (limit: 64KB)
+
+int main(int argc, char* argv[])
+{
+    int port = (argc > 1) ? std::atoi(argv[1]) : 10002;
+    npl::sockaddress<AF_INET> dst("127.0.0.1", port);
+
+    std::cout << "mode\tsyscalls/s\tsent dgram/s\treceived dgram/s\tMB/s" << std::endl;
+
+    for (bool gso : {false, true})
+    {
+        npl::socket<AF_INET, SOCK_DGRAM> rx;
+        rx.set_reuseaddr();
+        rx.bind(dst);
+        rx.set_gro();
+        int rcvbuf = 8 << 20;
+        rx.setsockopt(SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        timeval tv = {0, 100000};
+        rx.setsockopt(SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        std::atomic<bool> stop{false};
+        uint64_t received = 0;
+        std::thread receiver([&]() {
+            std::vector<std::byte> buf(65536);
+            npl::sockaddress<AF_INET> from;
+            uint16_t seg;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto n = rx.recvfrom_gro(buf, from, seg);
+                if (n > 0)
+                    received += npl::segment_view(std::span(buf).first(n), seg).size();
+            }
+        });
+
+        npl::socket<AF_INET, SOCK_DGRAM> tx;
+        std::vector<std::byte> payload(SEGMENT * SEGMENTS, std::byte{'x'});
+
+        uint64_t calls = 0, sent = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration<double>(0);
+        while (elapsed.count() < 1.0) {
+            if (gso) {
+                if (tx.sendto_gso(payload, dst, SEGMENT) > 0)
+                    sent += SEGMENTS;
+                ++calls;
+            } else {
+                for (int i = 0; i < SEGMENTS; ++i, ++calls) {
+                    if (tx.sendto(std::span(payload).first(SEGMENT), dst) > 0)
+                        ++sent;
+                }
+            }
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        stop = true;
+        receiver.join();
+
+        auto secs = elapsed.count();
+        std::cout << (gso ? "gso" : "sendto") << "\t" << static_cast<uint64_t>(calls / secs)
+                  << "\t\t" << static_cast<uint64_t>(sent / secs)
+                  << "\t\t" << static_cast<uint64_t>(received / secs)
+                  << "\t\t\t" << static_cast<uint64_t>(sent * SEGMENT / secs / 1e6) << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
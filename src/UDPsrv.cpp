@@ -2,6 +2,7 @@
 #include <cctype>
 #include <socket.hpp>
 #include <sockaddress.hpp>
+#include <span>
 #include <string>
 #include <iostream>
 #include <sys/socket.h>
@@ -13,14 +14,17 @@ int main() {
     // npl::sockaddress<AF_INET> srv_addr("127.0.0.1",srv_port);
     sock.bind(srv_addr);
 
+    npl::buffer buff(80);
+    npl::sockaddress<AF_INET> client;
     for(;;) {
-        auto [buff,client] = sock.recvfrom(80);
+        auto n = sock.recvfrom(std::as_writable_bytes(std::span(buff)), client);
+        if (n < 0)
+            continue;
         std::cout << "Received request from host: " << client.host() << " Port: " << client.port() << std::endl;
 
-        std::string text(buff.begin(),buff.end());
-        std::transform(text.begin(),text.end(),text.begin(),::toupper);
+        std::transform(buff.begin(),buff.begin()+n,buff.begin(),::toupper);
 
-        sock.sendto(npl::buffer(text.begin(),text.end()), client);
+        sock.sendto(std::as_bytes(std::span(buff).first(n)), client);
 
     }
 
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <flow_table.hpp>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// npl::flow_key::from must give the same key whether the frame went through
+// npl::packet or the batch decoder, fragments included: non-first fragments
+// have no L4 header and key as proto 0, ports 0. Also checks that expire()
+// keeps flows last seen after "now".
+
+using frame = std::vector<u_int8_t>;
+
+static int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cout << "FAIL: " << what << std::endl;
+        ++failures;
+    }
+}
+
+frame ether(u_int16_t type, const frame& payload)
+{
+    frame f(12, 0x02);
+    f.push_back(type >> 8); f.push_back(type & 0xff);
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+frame ipv4(u_int8_t proto, u_int16_t frag, const frame& payload)
+{
+    frame f(20, 0);
+    f.reserve(f.size() + payload.size());
+    f[0] = 0x45;
+    u_int16_t len = htons(20 + payload.size());
+    memcpy(&f[2], &len, 2);
+    f[6] = frag >> 8; f[7] = frag & 0xff;
+    f[8] = 64;
+    f[9] = proto;
+    f[12] = 10; f[15] = 1;
+    f[16] = 10; f[19] = 2;
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+frame ipv6(u_int8_t next, const frame& payload)
+{
+    frame f(40, 0);
+    f.reserve(f.size() + payload.size());
+    f[0] = 0x60;
+    f[4] = payload.size() >> 8; f[5] = payload.size() & 0xff;
+    f[6] = next;
+    f[7] = 64;
+    f[23] = 1; f[39] = 2;
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+frame ipv6_frag(u_int8_t next, u_int16_t offset, const frame& payload)
+{
+    frame f = {next, 0, static_cast<u_int8_t>(offset >> 5), static_cast<u_int8_t>((offset << 3) | 1), 0, 0, 0, 7};
+    f.reserve(f.size() + payload.size());
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+frame udp()
+{
+    frame f(8 + 16, 'y');
+    std::fill(f.begin(), f.begin() + 8, 0);
+    f[0] = 0x00; f[1] = 0x35;       // 53 -> 12345
+    f[2] = 0x30; f[3] = 0x39;
+    f[5] = 8 + 16;
+    return f;
+}
+
+frame tcp()
+{
+    frame f(20 + 32, 'x');
+    std::fill(f.begin(), f.begin() + 20, 0);
+    f[0] = 0x30; f[1] = 0x39;       // 12345 -> 443
+    f[2] = 0x01; f[3] = 0xbb;
+    f[12] = 5 << 4;
+    return f;
+}
+
+int main()
+{
+    frame data(40, 0xab);           // Fragment payload that looks like ports
+
+    struct test_case {
+        std::string name;
+        frame f;
+        u_int8_t proto;
+        u_int16_t lo_port, hi_port;
+    };
+    std::vector<test_case> cases = {
+        {"ipv4 tcp",                  ether(ETHERTYPE_IP, ipv4(IPPROTO_TCP, 0, tcp())), IPPROTO_TCP, 12345, 443},
+        {"ipv4 udp first fragment",   ether(ETHERTYPE_IP, ipv4(IPPROTO_UDP, IP_MF, udp())), IPPROTO_UDP, 53, 12345},
+        {"ipv4 udp later fragment",   ether(ETHERTYPE_IP, ipv4(IPPROTO_UDP, IP_MF | 185, data)), 0, 0, 0},
+        {"ipv4 tcp last fragment",    ether(ETHERTYPE_IP, ipv4(IPPROTO_TCP, 370, data)), 0, 0, 0},
+        {"ipv4 icmp",                 ether(ETHERTYPE_IP, ipv4(IPPROTO_ICMP, 0, frame(16, 0))), IPPROTO_ICMP, 0, 0},
+        {"ipv6 udp",                  ether(ETHERTYPE_IPV6, ipv6(IPPROTO_UDP, udp())), IPPROTO_UDP, 53, 12345},
+        {"ipv6 udp first fragment",   ether(ETHERTYPE_IPV6, ipv6(IPPROTO_FRAGMENT, ipv6_frag(IPPROTO_UDP, 0, udp()))), IPPROTO_UDP, 53, 12345},
+        {"ipv6 udp later fragment",   ether(ETHERTYPE_IPV6, ipv6(IPPROTO_FRAGMENT, ipv6_frag(IPPROTO_UDP, 185, data))), 0, 0, 0},
+    };
+
+    npl::frame_batch<16> batch;
+    for (auto& c : cases)
+        batch.add(c.f.data(), c.f.size());
+    npl::decode(batch);
+
+    for (size_t i = 0; i < cases.size(); ++i) {
+        auto& c = cases[i];
+        npl::packet<hdr::ether> pkt(c.f.data(), c.f.size());
+        auto from_packet = npl::flow_key::from(pkt);
+        auto from_batch = npl::flow_key::from(batch, i);
+        if (!from_packet || !from_batch) {
+            check(false, c.name + ": no key");
+            continue;
+        }
+        check(*from_packet == *from_batch, c.name + ": packet and batch keys differ");
+        check(from_packet->proto == c.proto, c.name + ": proto " + std::to_string(from_packet->proto));
+        check(from_packet->lo_port == c.lo_port && from_packet->hi_port == c.hi_port,
+              c.name + ": ports " + std::to_string(from_packet->lo_port) + "/" + std::to_string(from_packet->hi_port));
+    }
+
+    // A flow last seen after now is not idle
+    npl::flow_table table(16);
+    auto key = *npl::flow_key::from(batch, 0);
+    table.update(key, 100, 1000);
+    check(table.expire(990, 5) == 0 && table.find(key) != nullptr, "expire removed a flow seen after now");
+    check(table.expire(1010, 5) == 1 && table.find(key) == nullptr, "expire kept an idle flow");
+
+    std::cout << (failures ? "flow key checks failed" : "flow key checks passed") << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
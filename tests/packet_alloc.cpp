@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <packet.hpp>
+#include <vector>
+#include <iostream>
+
+// npl::packet must not touch the heap: parse representative frames (with
+// the header accessors a capture loop uses) under a counting operator new
+// and check that nothing was allocated, and that each frame gave the
+// expected layers and ports.
+
+static size_t allocations = 0;
+
+void* operator new(std::size_t n)
+{
+    ++allocations;
+    if (void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n)
+{
+    return ::operator new(n);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+using frame = std::vector<u_int8_t>;
+
+frame ether(u_int16_t type, const frame& payload, bool vlan = false)
+{
+    frame f(12, 0x02);
+    if (vlan) {
+        f.push_back(0x81); f.push_back(0x00);
+        f.push_back(0x00); f.push_back(0x0a);
+    }
+    f.push_back(type >> 8); f.push_back(type & 0xff);
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+frame ipv4(u_int8_t proto, const frame& payload)
+{
+    frame f(20, 0);
+    f[0] = 0x45;
+    u_int16_t len = htons(20 + payload.size());
+    memcpy(&f[2], &len, 2);
+    f[8] = 64;
+    f[9] = proto;
+    f[12] = 10; f[15] = 1;
+    f[16] = 10; f[19] = 2;
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+frame ipv6(u_int8_t next, const frame& payload)
+{
+    frame f(40, 0);
+    f[0] = 0x60;
+    f[4] = payload.size() >> 8; f[5] = payload.size() & 0xff;
+    f[6] = next;
+    f[7] = 64;
+    f[23] = 1; f[39] = 2;
+    f.insert(f.end(), payload.begin(), payload.end());
+    return f;
+}
+
+frame tcp(unsigned options = 0)
+{
+    frame f(20 + options, 0);
+    f[0] = 0x30; f[1] = 0x39;       // 12345 -> 443
+    f[2] = 0x01; f[3] = 0xbb;
+    f[12] = ((20 + options) / 4) << 4;
+    f.resize(f.size() + 32, 'x');
+    return f;
+}
+
+frame udp()
+{
+    frame f(8, 0);
+    f[0] = 0x00; f[1] = 0x35;
+    f[2] = 0x30; f[3] = 0x39;
+    f[5] = 8 + 16;
+    f.resize(f.size() + 16, 'y');
+    return f;
+}
+
+struct test_case {
+    const char* name;
+    frame f;
+    std::vector<hdr> layers;            // Expected dump()
+    u_int16_t sport, dport;             // Expected TCP/UDP ports (0: none)
+};
+
+int main()
+{
+    std::vector<test_case> cases = {
+        {"ipv4 tcp",         ether(ETHERTYPE_IP, ipv4(IPPROTO_TCP, tcp())),
+                             {hdr::ether, hdr::ipv4, hdr::tcp}, 12345, 443},
+        {"ipv4 tcp options", ether(ETHERTYPE_IP, ipv4(IPPROTO_TCP, tcp(12))),
+                             {hdr::ether, hdr::ipv4, hdr::tcp}, 12345, 443},
+        {"vlan ipv4 udp",    ether(ETHERTYPE_IP, ipv4(IPPROTO_UDP, udp()), true),
+                             {hdr::vlan, hdr::ipv4, hdr::udp}, 53, 12345},
+        {"ipv4 icmp",        ether(ETHERTYPE_IP, ipv4(IPPROTO_ICMP, frame(64, 0))),
+                             {hdr::ether, hdr::ipv4, hdr::icmp}, 0, 0},
+        {"ipv6 tcp",         ether(ETHERTYPE_IPV6, ipv6(IPPROTO_TCP, tcp())),
+                             {hdr::ether, hdr::ipv6, hdr::tcp}, 12345, 443},
+        {"ipv6 udp",         ether(ETHERTYPE_IPV6, ipv6(IPPROTO_UDP, udp())),
+                             {hdr::ether, hdr::ipv6, hdr::udp}, 53, 12345},
+        {"arp",              ether(ETHERTYPE_ARP, frame(28, 0)),
+                             {hdr::ether, hdr::arp}, 0, 0},
+        {"truncated ipv4",   ether(ETHERTYPE_IP, frame(10, 0)),
+                             {hdr::ether}, 0, 0},
+    };
+
+    // Results are checked inside the measured loop: comparing must not
+    // allocate either
+    std::vector<unsigned> wrong_layers(cases.size()), wrong_ports(cases.size());
+    size_t before = allocations;
+    for (int round = 0; round < 1000; ++round) {
+        for (size_t i = 0; i < cases.size(); ++i) {
+            auto& c = cases[i];
+            npl::packet<hdr::ether> pkt(c.f.data(), c.f.size());
+            auto layers = pkt.dump();
+            bool same = std::equal(layers.begin(), layers.end(), c.layers.begin(), c.layers.end(),
+                                   [](const auto& l, hdr h) { return l.first == h; });
+            wrong_layers[i] += !same;
+
+            u_int16_t sport = 0, dport = 0;
+            if (auto t = pkt.get<hdr::tcp>()) {
+                sport = t->srcport();
+                dport = t->dstport();
+            } else if (auto u = pkt.get<hdr::udp>()) {
+                sport = u->srcport();
+                dport = u->dstport();
+            }
+            wrong_ports[i] += (sport != c.sport || dport != c.dport);
+        }
+    }
+    size_t allocated = allocations - before;
+
+    std::cout << cases.size() * 1000 << " frames parsed, " << allocated << " allocations" << std::endl;
+    int failures = 0;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        if (wrong_layers[i]) {
+            std::cout << "FAIL: " << cases[i].name << ": unexpected layers" << std::endl;
+            ++failures;
+        }
+        if (wrong_ports[i]) {
+            std::cout << "FAIL: " << cases[i].name << ": unexpected ports" << std::endl;
+            ++failures;
+        }
+    }
+    if (allocated != 0) {
+        std::cout << "FAIL: parsing allocated" << std::endl;
+        ++failures;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}